@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+
+// Bump allocator for the syntax tree. Nodes are carved out of large blocks one after the other
+// and are all released together when the arena goes away, so there's no per-node allocation or reference counting.
+class Arena{
+  private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    struct Destructor{
+      void* object;
+      void (*destroy)(void* object);
+    };
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    std::byte* next = nullptr;
+    size_t remaining = 0;
+    std::vector<Destructor> destructors; // Only for objects that actually need to run a destructor.
+
+    void* allocate(size_t size, size_t alignment){
+      size_t padding = (alignment - reinterpret_cast<uintptr_t>(next) % alignment) % alignment;
+
+      if(next == nullptr || padding + size > remaining){
+        size_t blockSize = size + alignment > BLOCK_SIZE ? size + alignment : BLOCK_SIZE;
+        blocks.push_back(std::make_unique<std::byte[]>(blockSize));
+        next = blocks.back().get();
+        remaining = blockSize;
+        padding = (alignment - reinterpret_cast<uintptr_t>(next) % alignment) % alignment;
+      }
+
+      void* memory = next + padding;
+      next += padding + size;
+      remaining -= padding + size;
+
+      return memory;
+    }
+
+  public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena(){
+      for(auto it = destructors.rbegin(); it != destructors.rend(); it++){
+        it->destroy(it->object);
+      }
+    }
+
+    template<class T, class... Args>
+    T* make(Args&&... args){
+      T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+      if constexpr(!std::is_trivially_destructible_v<T>){
+        destructors.push_back(Destructor{object, [](void* object){ static_cast<T*>(object)->~T(); }});
+      }
+
+      return object;
+    }
+};
@@ -1,14 +1,16 @@
 #include "AstPrinter.hpp"
+#include "Arena.hpp"
 
 int main(){
-  std::shared_ptr<Expr> expression = std::make_shared<Binary>(
-    std::make_shared<Unary>(
-      Token(1, TokenType::MINUS, nullptr, "-"),
-      std::make_shared<Literal>(123.00)
+  Arena arena;
+  Expr* expression = arena.make<Binary>(
+    arena.make<Unary>(
+      Token(1, TokenType::MINUS, "-"),
+      arena.make<Literal>(123.00)
     ),
-    Token(1, TokenType::STAR, nullptr, "*"),
-    std::make_shared<Grouping>(
-      std::make_shared<Literal>(45.67)
+    Token(1, TokenType::STAR, "*"),
+    arena.make<Grouping>(
+      arena.make<Literal>(45.67)
     )
   );
 
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "Token.hpp"
+#include "Value.hpp"
+#include "PropertyCache.hpp"
+
+struct Class;
+struct Function;
+
+enum OpCode : uint8_t{
+  // Constants and Literals
+  OP_CONSTANT,      // [index: u16] Pushes constants[index].
+  OP_NIL,
+  OP_TRUE,
+  OP_FALSE,
+  OP_POP,
+
+  // Variables
+  OP_GET_LOCAL,     // [depth: u16, slot: u16] Same addressing the Resolver stored in the AST.
+  OP_SET_LOCAL,     // [depth: u16, slot: u16] Leaves the assigned value on the stack.
+  OP_DEFINE_LOCAL,  // Pops the value into the next free slot of the current environment.
+  OP_GET_STACK,     // [slot: u16] Variables that live in the current frame of the value stack (LocalSlot::onStack).
+  OP_SET_STACK,     // [slot: u16] Leaves the assigned value on the stack.
+  OP_GET_GLOBAL,    // The name comes from the instruction's token.
+  OP_SET_GLOBAL,
+  OP_DEFINE_GLOBAL,
+
+  // Properties
+  OP_GET_PROPERTY,  // [cache: u16] The property name comes from the instruction's token. caches[cache] is the node's inline cache.
+  OP_SET_PROPERTY,  // [cache: u16]
+  OP_GET_SUPER,     // [depth: u16] Depth of the 'super' scope. Pops the receiver ('this') the method is bound to.
+
+  // Operators
+  OP_EQUAL,
+  OP_NOT_EQUAL,
+  OP_GREATER,
+  OP_GREATER_EQUAL,
+  OP_LESS,
+  OP_LESS_EQUAL,
+  OP_ADD,
+  OP_SUBTRACT,
+  OP_MULTIPLY,
+  OP_DIVIDE,
+  OP_NOT,
+  OP_NEGATE,
+
+  // Statements and Control Flow
+  OP_PRINT,
+  OP_JUMP,          // [offset: u16] Forward jump.
+  OP_JUMP_IF_FALSE, // [offset: u16] Forward jump. Leaves the condition on the stack.
+  OP_LOOP,          // [offset: u16] Backward jump.
+  OP_PUSH_SCOPE,    // Enters a block: creates a new environment enclosed by the current one.
+  OP_POP_SCOPE,
+  OP_ENTER_FRAME,   // [size: u16] Enters a block whose variables live on the value stack: saves the slot base and pushes 'size' slots for them.
+  OP_LEAVE_FRAME,   // [size: u16] Pops them and restores the slot base.
+
+  // Functions and Classes
+  OP_CALL,          // [argCount: u8]
+  OP_INVOKE,        // [cache: u16, argCount: u8] "object.name(...)". The opcode's token is the name, the argument count's is the ')'.
+  OP_FUNCTION,      // [index: u16] Creates a LoxFunction for functions[index], closing over the current environment.
+  OP_CLASS,         // [index: u16] Creates a LoxClass for classes[index]. Pops the superclass first, if it has one.
+  OP_RETURN
+};
+
+// A compiled sequence of bytecode. There's one Chunk for the top-level script and one for each function body.
+struct Chunk{
+  std::vector<uint8_t> code;
+  std::vector<const Token*> tokens; // Source token of the instruction each byte belongs to, used for names and error reporting. Null for instructions that can't fail.
+  std::vector<Value> constants;
+  std::vector<Function*> functions;
+  std::vector<Class*> classes;
+  std::vector<PropertyCache*> caches; // Inline caches of the 'Get'/'Set' nodes, so the VM warms up the same caches as the Interpreter.
+
+  void write(uint8_t byte, const Token* token){
+    code.push_back(byte);
+    tokens.push_back(token);
+
+    return;
+  }
+
+  void writeShort(uint16_t value, const Token* token){
+    write(static_cast<uint8_t>(value & 0xff), token);
+    write(static_cast<uint8_t>(value >> 8), token);
+
+    return;
+  }
+
+  int addCache(PropertyCache* cache){
+    caches.push_back(cache);
+
+    return caches.size() - 1;
+  }
+
+  int addConstant(Value value){
+    constants.push_back(std::move(value));
+
+    return constants.size() - 1;
+  }
+};
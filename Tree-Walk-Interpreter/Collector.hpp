@@ -0,0 +1,168 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <cstddef>
+#include <ostream>
+#include <algorithm>
+
+#include "Value.hpp"
+#include "Object.hpp"
+
+// Frees the reference cycles that reference counting alone can't: a closure stored in the environment it captured, an instance
+// holding a bound method of itself, a class whose methods close over the scope the class lives in...
+//
+// Every object that can reference other objects is tracked (see Object::track). A collection is a mark-sweep over them:
+//   1. For each tracked object, count how many of its references come from other tracked objects (by tracing all of them).
+//   2. The ones with more references than that are also referenced from somewhere else: a Value on the C++ stack, the VM's stack,
+//      the Interpreter's current environment... Those are the roots. Everything reachable from them is marked as alive.
+//   3. Whatever wasn't marked is only referenced by other garbage. Their references are cleared, which breaks the cycles,
+//      and then reference counting frees them as usual.
+// The roots never have to be listed explicitly, since every reference to an object outside of the heap is counted.
+//
+// Collections only run at safe points (calls and loop iterations), once the number of tracked objects reaches a threshold.
+// After each collection the threshold becomes 'growth' times the number of objects that survived it (and never less than the
+// initial threshold), so the cost of collecting stays proportional to the amount of allocation.
+class Collector{
+  public:
+    struct Stats{
+      size_t collections = 0;
+      size_t freed = 0;
+      std::chrono::nanoseconds totalPause{0};
+      std::chrono::nanoseconds maxPause{0};
+    };
+
+  private:
+    enum class Phase{
+      SUBTRACT, // Discount the references that come from tracked objects.
+      MARK      // Mark what's reachable from the roots.
+    };
+
+    size_t initialThreshold = 10000;
+    double growth = 2.0;
+    size_t threshold = initialThreshold;
+    Stats stats;
+
+    Phase phase = Phase::SUBTRACT;
+    std::vector<Object*> worklist;
+
+    Collector() = default;
+
+  public:
+    static Collector& instance(){
+      static Collector collector;
+
+      return collector;
+    }
+
+    void configure(size_t initialThreshold, double growth){
+      this->initialThreshold = initialThreshold;
+      this->growth = growth;
+      threshold = initialThreshold;
+
+      return;
+    }
+
+    const Stats& statistics() const{
+      return stats;
+    }
+
+    // Called at safe points: every object alive at that moment is either tracked or referenced by a counted reference.
+    void collectIfNeeded(){
+      if(Object::trackedObjects.size() >= threshold){
+        collect();
+      }
+
+      return;
+    }
+
+    void visit(Object* object){
+      if(object->trackedIndex < 0) return; // Strings and natives don't reference anything.
+
+      if(phase == Phase::SUBTRACT){
+        object->gcRefs--;
+      }else if(object->gcRefs == 0){
+        object->gcRefs = 1;
+        worklist.push_back(object);
+      }
+
+      return;
+    }
+
+    void visit(const Value& value){
+      if(value.isObject()){
+        visit(value.asObject());
+      }
+
+      return;
+    }
+
+    // Frees every tracked object that's only referenced from garbage. Returns how many objects were freed.
+    size_t collect(){
+      auto start = std::chrono::steady_clock::now();
+      std::vector<Object*>& objects = Object::trackedObjects;
+
+      for(Object* object : objects){
+        object->gcRefs = object->refCount;
+      }
+
+      phase = Phase::SUBTRACT;
+      for(Object* object : objects){
+        object->traceReferences(*this);
+      }
+
+      phase = Phase::MARK;
+      for(Object* object : objects){
+        if(object->gcRefs > 0){
+          worklist.push_back(object);
+        }
+      }
+      while(!worklist.empty()){
+        Object* object = worklist.back();
+        worklist.pop_back();
+        object->traceReferences(*this);
+      }
+
+      std::vector<Object*> garbage;
+      for(Object* object : objects){
+        if(object->gcRefs == 0){
+          garbage.push_back(object);
+        }
+      }
+
+      // Hold on to every piece of garbage while the cycles are broken, so none of them is freed while others still point to it.
+      for(Object* object : garbage){
+        object->retain();
+      }
+      for(Object* object : garbage){
+        object->clearReferences();
+      }
+      for(Object* object : garbage){
+        object->release();
+      }
+
+      threshold = std::max(initialThreshold, static_cast<size_t>(objects.size() * growth));
+
+      auto pause = std::chrono::steady_clock::now() - start;
+      stats.collections++;
+      stats.freed += garbage.size();
+      stats.totalPause += pause;
+      stats.maxPause = std::max(stats.maxPause, std::chrono::duration_cast<std::chrono::nanoseconds>(pause));
+
+      return garbage.size();
+    }
+
+    void report(std::ostream& out) const{
+      using Microseconds = std::chrono::duration<double, std::micro>;
+
+      out << "[gc] " << stats.collections << " collections, " << stats.freed << " objects freed, "
+          << Object::trackedObjects.size() << " tracked objects alive.\n";
+      if(stats.collections > 0){
+        out << "[gc] pause total " << Microseconds{stats.totalPause}.count() << " us, mean "
+            << Microseconds{stats.totalPause}.count() / stats.collections << " us, max "
+            << Microseconds{stats.maxPause}.count() << " us.\n";
+      }
+
+      return;
+    }
+};
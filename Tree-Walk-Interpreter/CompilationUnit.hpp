@@ -0,0 +1,16 @@
+#pragma once
+
+#include <vector>
+
+#include "Arena.hpp"
+#include "Stmt.hpp"
+#include "SourceBuffer.hpp"
+
+// Everything produced from one piece of source code (a script file or a line typed in the prompt).
+// All of its AST nodes live in the arena and their tokens point into the source, so a unit has to outlive every runtime object
+// that points into its tree (e.g. a LoxFunction's declaration).
+struct CompilationUnit{
+  SourceBuffer source;
+  Arena arena;
+  std::vector<Stmt*> statements;
+};
\ No newline at end of file
@@ -0,0 +1,447 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+#include "Expr.hpp"
+#include "Stmt.hpp"
+#include "Chunk.hpp"
+#include "Error.hpp"
+#include "Token.hpp"
+#include "Value.hpp"
+
+// Translates the (already resolved) syntax tree into bytecode for the VM.
+// Variable accesses reuse the depth and slot the Resolver stored in the AST, so the VM keeps exactly the same scoping rules as the Interpreter.
+class Compiler : public ExprVisitor, public StmtVisitor{
+  private:
+    std::shared_ptr<Chunk> chunk;
+    int scopeDepth = 0; // 0 means we're compiling top-level code, where declarations create globals.
+    int line = 0; // Line of the most recent token, used when reporting compile errors.
+
+    void compile(Stmt* stmt){
+      stmt->accept(*this);
+
+      return;
+    }
+
+    void compile(Expr* expr){
+      expr->accept(*this);
+
+      return;
+    }
+
+    void compile(const std::vector<Stmt*>& statements){
+      for(Stmt* statement : statements){
+        compile(statement);
+      }
+
+      return;
+    }
+
+    void emit(uint8_t byte, const Token* token = nullptr){
+      if(token != nullptr) line = token->line;
+      chunk->write(byte, token);
+
+      return;
+    }
+
+    void emitShort(uint16_t value, const Token* token = nullptr){
+      chunk->writeShort(value, token);
+
+      return;
+    }
+
+    void emitConstant(Value value){
+      int index = chunk->addConstant(std::move(value));
+      if(index > UINT16_MAX){
+        error(line, "Too many constants in one chunk.");
+      }
+
+      emit(OP_CONSTANT);
+      emitShort(index);
+
+      return;
+    }
+
+    // Emits the operand of a property access: the index of the node's inline cache.
+    void emitCache(PropertyCache* cache, const Token& name){
+      int index = chunk->addCache(cache);
+      if(index > UINT16_MAX){
+        error(name, "Too many property accesses in one chunk.");
+      }
+      emitShort(index, &name);
+
+      return;
+    }
+
+    // Emits a jump with a placeholder offset and returns where the offset is, so it can be patched later.
+    int emitJump(OpCode instruction){
+      emit(instruction);
+      emitShort(UINT16_MAX);
+
+      return chunk->code.size() - 2;
+    }
+
+    void patchJump(int offset){
+      int jump = chunk->code.size() - offset - 2;
+      if(jump > UINT16_MAX){
+        error(line, "Too much code to jump over.");
+      }
+
+      chunk->code[offset] = jump & 0xff;
+      chunk->code[offset + 1] = (jump >> 8) & 0xff;
+
+      return;
+    }
+
+    void emitLoop(int loopStart){
+      emit(OP_LOOP);
+
+      int offset = chunk->code.size() - loopStart + 2;
+      if(offset > UINT16_MAX){
+        error(line, "Loop body too large.");
+      }
+      emitShort(offset);
+
+      return;
+    }
+
+    void emitGetVariable(const LocalSlot& local, const Token& name){
+      if(local.onStack){
+        emit(OP_GET_STACK, &name);
+        emitShort(local.slot);
+      }else if(local.depth != -1){
+        emit(OP_GET_LOCAL, &name);
+        emitShort(local.depth);
+        emitShort(local.slot);
+      }else{
+        emit(OP_GET_GLOBAL, &name);
+      }
+
+      return;
+    }
+
+    // Binds the value on top of the stack to a newly declared variable in the innermost scope.
+    void emitDefine(const Token& name){
+      emit(scopeDepth == 0 ? OP_DEFINE_GLOBAL : OP_DEFINE_LOCAL, &name);
+
+      return;
+    }
+
+    void compileFunction(Function* function){
+      std::shared_ptr<Chunk> enclosingChunk = chunk;
+      int enclosingDepth = scopeDepth;
+
+      chunk = std::make_shared<Chunk>();
+      scopeDepth = 1;
+
+      // The body runs directly in the environment that holds the parameters, just like LoxFunction::call.
+      compile(function->body);
+      emit(OP_NIL);
+      emit(OP_RETURN);
+
+      function->chunk = chunk;
+
+      chunk = enclosingChunk;
+      scopeDepth = enclosingDepth;
+
+      return;
+    }
+
+  public:
+    std::shared_ptr<Chunk> compileScript(const std::vector<Stmt*>& statements){
+      chunk = std::make_shared<Chunk>();
+      scopeDepth = 0;
+
+      compile(statements);
+      emit(OP_NIL);
+      emit(OP_RETURN);
+
+      return std::move(chunk);
+    }
+
+    void visitBlockStmt(Block* stmt) override{
+      if(!stmt->onStack){
+        emit(OP_PUSH_SCOPE);
+      }else if(stmt->frameSize > 0){
+        emit(OP_ENTER_FRAME);
+        emitShort(stmt->frameSize);
+      }
+
+      scopeDepth++;
+      compile(stmt->statements);
+      scopeDepth--;
+
+      if(!stmt->onStack){
+        emit(OP_POP_SCOPE);
+      }else if(stmt->frameSize > 0){
+        emit(OP_LEAVE_FRAME);
+        emitShort(stmt->frameSize);
+      }
+
+      return;
+    }
+
+    void visitClassStmt(Class* stmt) override{
+      for(Function* method : stmt->methods){
+        compileFunction(method);
+      }
+
+      if(stmt->superclass != nullptr){
+        compile(stmt->superclass);
+      }
+
+      chunk->classes.push_back(stmt);
+      emit(OP_CLASS, &stmt->name);
+      emitShort(chunk->classes.size() - 1);
+      emitDefine(stmt->name);
+
+      return;
+    }
+
+    void visitExpressionStmt(Expression* stmt) override{
+      compile(stmt->expression);
+      emit(OP_POP);
+
+      return;
+    }
+
+    void visitFunctionStmt(Function* stmt) override{
+      compileFunction(stmt);
+
+      chunk->functions.push_back(stmt);
+      emit(OP_FUNCTION, &stmt->name);
+      emitShort(chunk->functions.size() - 1);
+      emitDefine(stmt->name);
+
+      return;
+    }
+
+    void visitIfStmt(If* stmt) override{
+      compile(stmt->condition);
+
+      int thenJump = emitJump(OP_JUMP_IF_FALSE);
+      emit(OP_POP);
+      compile(stmt->ifBranch);
+
+      int elseJump = emitJump(OP_JUMP);
+      patchJump(thenJump);
+      emit(OP_POP);
+      if(stmt->elseBranch != nullptr){
+        compile(stmt->elseBranch);
+      }
+      patchJump(elseJump);
+
+      return;
+    }
+
+    void visitPrintStmt(Print* stmt) override{
+      compile(stmt->expression);
+      emit(OP_PRINT);
+
+      return;
+    }
+
+    void visitReturnStmt(Return* stmt) override{
+      if(stmt->value != nullptr){
+        compile(stmt->value);
+      }else{
+        emit(OP_NIL);
+      }
+      emit(OP_RETURN, &stmt->keyword);
+
+      return;
+    }
+
+    void visitVarStmt(Var* stmt) override{
+      if(stmt->initializer != nullptr){
+        compile(stmt->initializer);
+      }else{
+        emit(OP_NIL);
+      }
+
+      if(stmt->local.onStack){
+        emit(OP_SET_STACK, &stmt->name);
+        emitShort(stmt->local.slot);
+        emit(OP_POP);
+      }else{
+        emitDefine(stmt->name);
+      }
+
+      return;
+    }
+
+    void visitWhileStmt(While* stmt) override{
+      int loopStart = chunk->code.size();
+      compile(stmt->condition);
+
+      int exitJump = emitJump(OP_JUMP_IF_FALSE);
+      emit(OP_POP);
+      compile(stmt->body);
+      emitLoop(loopStart);
+
+      patchJump(exitJump);
+      emit(OP_POP);
+
+      return;
+    }
+
+    Value visitAssignExpr(Assign* expr) override{
+      compile(expr->value);
+
+      if(expr->local.onStack){
+        emit(OP_SET_STACK, &expr->name);
+        emitShort(expr->local.slot);
+      }else if(expr->local.depth != -1){
+        emit(OP_SET_LOCAL, &expr->name);
+        emitShort(expr->local.depth);
+        emitShort(expr->local.slot);
+      }else{
+        emit(OP_SET_GLOBAL, &expr->name);
+      }
+
+      return {};
+    }
+
+    Value visitBinaryExpr(Binary* expr) override{
+      compile(expr->left);
+      compile(expr->right);
+
+      switch(expr->op.type){
+        case TokenType::PLUS:          emit(OP_ADD, &expr->op); break;
+        case TokenType::MINUS:         emit(OP_SUBTRACT, &expr->op); break;
+        case TokenType::STAR:          emit(OP_MULTIPLY, &expr->op); break;
+        case TokenType::SLASH:         emit(OP_DIVIDE, &expr->op); break;
+        case TokenType::GREATER:       emit(OP_GREATER, &expr->op); break;
+        case TokenType::GREATER_EQUAL: emit(OP_GREATER_EQUAL, &expr->op); break;
+        case TokenType::LESS:          emit(OP_LESS, &expr->op); break;
+        case TokenType::LESS_EQUAL:    emit(OP_LESS_EQUAL, &expr->op); break;
+        case TokenType::BANG_EQUAL:    emit(OP_NOT_EQUAL, &expr->op); break;
+        case TokenType::EQUAL_EQUAL:   emit(OP_EQUAL, &expr->op); break;
+        default: break; // Unreachable
+      }
+
+      return {};
+    }
+
+    Value visitCallExpr(Call* expr) override{
+      if(expr->method != nullptr){
+        // Method calls skip OP_GET_PROPERTY, so the method doesn't have to be bound to the object.
+        compile(expr->method->object);
+        for(Expr* argument : expr->arguments){
+          compile(argument);
+        }
+
+        emit(OP_INVOKE, &expr->method->name);
+        emitCache(&expr->method->cache, expr->method->name);
+        emit(expr->arguments.size(), &expr->paren);
+
+        return {};
+      }
+
+      compile(expr->callee);
+      for(Expr* argument : expr->arguments){
+        compile(argument);
+      }
+
+      emit(OP_CALL, &expr->paren);
+      emit(expr->arguments.size(), &expr->paren);
+
+      return {};
+    }
+
+    Value visitGetExpr(Get* expr) override{
+      compile(expr->object);
+      emit(OP_GET_PROPERTY, &expr->name);
+      emitCache(&expr->cache, expr->name);
+
+      return {};
+    }
+
+    Value visitGroupingExpr(Grouping* expr) override{
+      compile(expr->expression);
+
+      return {};
+    }
+
+    Value visitLiteralExpr(Literal* expr) override{
+      const Value& value = expr->value;
+
+      if(value.isNil()){
+        emit(OP_NIL);
+      }else if(value.isBool()){
+        emit(value.asBool() ? OP_TRUE : OP_FALSE);
+      }else{
+        emitConstant(value);
+      }
+
+      return {};
+    }
+
+    Value visitLogicalExpr(Logical* expr) override{
+      compile(expr->left);
+
+      if(expr->op.type == TokenType::OR){
+        // Short-Circuit: if the left operand is truthy, skip over the right operand and keep the left one as the result.
+        int elseJump = emitJump(OP_JUMP_IF_FALSE);
+        int endJump = emitJump(OP_JUMP);
+
+        patchJump(elseJump);
+        emit(OP_POP);
+        compile(expr->right);
+        patchJump(endJump);
+      }else{
+        // Short-Circuit: if the left operand is falsey, skip over the right operand and keep the left one as the result.
+        int endJump = emitJump(OP_JUMP_IF_FALSE);
+
+        emit(OP_POP);
+        compile(expr->right);
+        patchJump(endJump);
+      }
+
+      return {};
+    }
+
+    Value visitSetExpr(Set* expr) override{
+      compile(expr->object);
+      compile(expr->value);
+      emit(OP_SET_PROPERTY, &expr->name);
+      emitCache(&expr->cache, expr->name);
+
+      return {};
+    }
+
+    Value visitSuperExpr(Super* expr) override{
+      emitGetVariable(expr->thisLocal, expr->keyword);
+      emit(OP_GET_SUPER, &expr->method);
+      emitShort(expr->local.depth);
+
+      return {};
+    }
+
+    Value visitThisExpr(This* expr) override{
+      emitGetVariable(expr->local, expr->keyword);
+
+      return {};
+    }
+
+    Value visitUnaryExpr(Unary* expr) override{
+      compile(expr->right);
+
+      switch(expr->op.type){
+        case TokenType::BANG:  emit(OP_NOT, &expr->op); break;
+        case TokenType::MINUS: emit(OP_NEGATE, &expr->op); break;
+        default: break; // Unreachable
+      }
+
+      return {};
+    }
+
+    Value visitVariableExpr(Variable* expr) override{
+      emitGetVariable(expr->local, expr->name);
+
+      return {};
+    }
+};
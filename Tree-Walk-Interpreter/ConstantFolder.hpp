@@ -0,0 +1,322 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "Expr.hpp"
+#include "Stmt.hpp"
+#include "Arena.hpp"
+#include "Value.hpp"
+#include "LoxString.hpp"
+#include "Interpreter.hpp"
+
+// Optimization pass that runs between the Resolver and the Interpreter (or the Compiler).
+// Operators whose operands are all literals are evaluated once, here, and replaced by a Literal with the result:
+// "60 * 60 * 24" becomes "86400", "!true" becomes "false" and "\"a\" + \"b\"" becomes "\"ab\"".
+// 'and'/'or' with a literal on the left become whichever operand they'd evaluate to, and so do 'if' and 'while' with a literal condition.
+// Operations that would fail at runtime (like "-\"text\"" or "1 + nil") are left alone, so they still fail at runtime, when
+// and if they're executed. Variables are never folded, not even the ones that are only assigned once.
+// Nothing is removed that could declare a variable, so the slots the Resolver assigned stay valid.
+class ConstantFolder : public ExprVisitor, public StmtVisitor{
+  private:
+    Arena& arena;
+    Expr* expression = nullptr; // What the expression being visited should be replaced with.
+    Stmt* statement = nullptr;  // Same for statements. Null removes the statement.
+
+    Expr* fold(Expr* expr){
+      expression = expr;
+      expr->accept(*this);
+
+      return expression;
+    }
+
+    Stmt* fold(Stmt* stmt){
+      statement = stmt;
+      stmt->accept(*this);
+
+      return statement;
+    }
+
+    void fold(std::vector<Stmt*>& statements){
+      std::vector<Stmt*> folded;
+      folded.reserve(statements.size());
+      for(Stmt* stmt : statements){
+        Stmt* result = fold(stmt);
+        if(result != nullptr) folded.push_back(result);
+      }
+      statements = std::move(folded);
+
+      return;
+    }
+
+    // For statements that can't just disappear, like the body of a loop.
+    Stmt* foldRequired(Stmt* stmt){
+      Stmt* result = fold(stmt);
+      if(result != nullptr) return result;
+
+      Block* empty = arena.make<Block>(std::vector<Stmt*>{});
+      empty->onStack = true; // No variables, so no Environment either.
+
+      return empty;
+    }
+
+    static Literal* literal(Expr* expr){
+      return dynamic_cast<Literal*>(expr);
+    }
+
+    void replaceWith(Value value){
+      expression = arena.make<Literal>(std::move(value));
+
+      return;
+    }
+
+  public:
+    ConstantFolder(Arena& arena)
+      : arena{arena}
+    {}
+
+    void optimize(std::vector<Stmt*>& statements){
+      fold(statements);
+
+      return;
+    }
+
+    void visitBlockStmt(Block* stmt) override{
+      fold(stmt->statements);
+      statement = stmt;
+
+      return;
+    }
+
+    void visitClassStmt(Class* stmt) override{
+      for(Function* method : stmt->methods){
+        fold(method->body);
+      }
+      statement = stmt;
+
+      return;
+    }
+
+    void visitExpressionStmt(Expression* stmt) override{
+      stmt->expression = fold(stmt->expression);
+      statement = stmt;
+
+      return;
+    }
+
+    void visitFunctionStmt(Function* stmt) override{
+      fold(stmt->body);
+      statement = stmt;
+
+      return;
+    }
+
+    void visitIfStmt(If* stmt) override{
+      stmt->condition = fold(stmt->condition);
+
+      if(Literal* condition = literal(stmt->condition)){
+        // Only the branch that would run is kept (a branch is never a declaration, so it can't hold a variable of this scope).
+        if(Interpreter::isTruthy(condition->value)){
+          statement = fold(stmt->ifBranch);
+        }else{
+          statement = stmt->elseBranch != nullptr ? fold(stmt->elseBranch) : nullptr;
+        }
+        return;
+      }
+
+      stmt->ifBranch = foldRequired(stmt->ifBranch);
+      if(stmt->elseBranch != nullptr){
+        stmt->elseBranch = fold(stmt->elseBranch);
+      }
+      statement = stmt;
+
+      return;
+    }
+
+    void visitPrintStmt(Print* stmt) override{
+      stmt->expression = fold(stmt->expression);
+      statement = stmt;
+
+      return;
+    }
+
+    void visitReturnStmt(Return* stmt) override{
+      if(stmt->value != nullptr){
+        stmt->value = fold(stmt->value);
+        stmt->tailCall = Return::isTailCall(stmt->value); // Folding may have rewritten the value: "return (f());" is "return f();" now.
+      }
+      statement = stmt;
+
+      return;
+    }
+
+    void visitVarStmt(Var* stmt) override{
+      if(stmt->initializer != nullptr){
+        stmt->initializer = fold(stmt->initializer);
+      }
+      statement = stmt;
+
+      return;
+    }
+
+    void visitWhileStmt(While* stmt) override{
+      stmt->condition = fold(stmt->condition);
+
+      Literal* condition = literal(stmt->condition);
+      if(condition != nullptr && !Interpreter::isTruthy(condition->value)){
+        statement = nullptr; // The body never runs.
+        return;
+      }
+
+      stmt->body = foldRequired(stmt->body);
+      statement = stmt;
+
+      return;
+    }
+
+    Value visitAssignExpr(Assign* expr) override{
+      expr->value = fold(expr->value);
+      expression = expr;
+
+      return {};
+    }
+
+    Value visitBinaryExpr(Binary* expr) override{
+      expr->left = fold(expr->left);
+      expr->right = fold(expr->right);
+      expression = expr;
+
+      Literal* leftLiteral = literal(expr->left);
+      Literal* rightLiteral = literal(expr->right);
+      if(leftLiteral == nullptr || rightLiteral == nullptr) return {};
+
+      const Value& left = leftLiteral->value;
+      const Value& right = rightLiteral->value;
+
+      // Same semantics as Interpreter::visitBinaryExpr. Whatever would throw a RuntimeError there is kept as it is.
+      switch(expr->op.type){
+        case TokenType::BANG_EQUAL:
+          replaceWith(!Interpreter::isEqual(left, right));
+          return {};
+        case TokenType::EQUAL_EQUAL:
+          replaceWith(Interpreter::isEqual(left, right));
+          return {};
+        case TokenType::PLUS:
+          if(left.isString() && right.isString()){
+            std::string chars{left.asObject<LoxString>()->chars()};
+            chars += right.asObject<LoxString>()->chars();
+            replaceWith(intern(chars));
+            return {};
+          }
+          break;
+        default:
+          break;
+      }
+
+      if(!left.isNumber() || !right.isNumber()) return {};
+
+      double a = left.asNumber();
+      double b = right.asNumber();
+      switch(expr->op.type){
+        case TokenType::PLUS:          replaceWith(a + b); break;
+        case TokenType::MINUS:         replaceWith(a - b); break;
+        case TokenType::STAR:          replaceWith(a * b); break;
+        case TokenType::SLASH:         replaceWith(a / b); break;
+        case TokenType::GREATER:       replaceWith(a > b); break;
+        case TokenType::GREATER_EQUAL: replaceWith(a >= b); break;
+        case TokenType::LESS:          replaceWith(a < b); break;
+        case TokenType::LESS_EQUAL:    replaceWith(a <= b); break;
+        default: break;
+      }
+
+      return {};
+    }
+
+    Value visitCallExpr(Call* expr) override{
+      if(expr->method == nullptr){
+        expr->callee = fold(expr->callee);
+      }else{
+        expr->method->object = fold(expr->method->object); // The callee is the Get itself, which the Call refers to directly.
+      }
+      for(Expr*& argument : expr->arguments){
+        argument = fold(argument);
+      }
+      expression = expr;
+
+      return {};
+    }
+
+    Value visitGetExpr(Get* expr) override{
+      expr->object = fold(expr->object);
+      expression = expr;
+
+      return {};
+    }
+
+    Value visitGroupingExpr(Grouping* expr) override{
+      expr->expression = fold(expr->expression);
+      expression = literal(expr->expression) != nullptr ? expr->expression : expr;
+
+      return {};
+    }
+
+    Value visitLiteralExpr(Literal*) override{
+      return {};
+    }
+
+    Value visitLogicalExpr(Logical* expr) override{
+      expr->left = fold(expr->left);
+      expr->right = fold(expr->right);
+      expression = expr;
+
+      Literal* left = literal(expr->left);
+      if(left == nullptr) return {};
+
+      // "true or x" is "true" and "false or x" is "x" (whatever it evaluates to). The other way around for 'and'.
+      bool truthy = Interpreter::isTruthy(left->value);
+      if(expr->op.type == TokenType::OR){
+        expression = truthy ? expr->left : expr->right;
+      }else{
+        expression = truthy ? expr->right : expr->left;
+      }
+
+      return {};
+    }
+
+    Value visitSetExpr(Set* expr) override{
+      expr->object = fold(expr->object);
+      expr->value = fold(expr->value);
+      expression = expr;
+
+      return {};
+    }
+
+    Value visitSuperExpr(Super*) override{
+      return {};
+    }
+
+    Value visitThisExpr(This*) override{
+      return {};
+    }
+
+    Value visitUnaryExpr(Unary* expr) override{
+      expr->right = fold(expr->right);
+      expression = expr;
+
+      Literal* right = literal(expr->right);
+      if(right == nullptr) return {};
+
+      if(expr->op.type == TokenType::BANG){
+        replaceWith(!Interpreter::isTruthy(right->value));
+      }else if(expr->op.type == TokenType::MINUS && right->value.isNumber()){
+        replaceWith(-right->value.asNumber());
+      }
+
+      return {};
+    }
+
+    Value visitVariableExpr(Variable*) override{
+      return {};
+    }
+};
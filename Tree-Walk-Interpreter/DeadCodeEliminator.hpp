@@ -0,0 +1,261 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <unordered_set>
+
+#include "Expr.hpp"
+#include "Stmt.hpp"
+#include "Arena.hpp"
+#include "Value.hpp"
+#include "Interpreter.hpp"
+
+// Counts the nodes (statements and expressions) of a subtree, so the DeadCodeEliminator can report how much it removed.
+class NodeCounter : public ExprVisitor, public StmtVisitor{
+  private:
+    size_t count = 0;
+
+    void add(Expr* expr){
+      if(expr != nullptr) expr->accept(*this);
+
+      return;
+    }
+
+    void add(Stmt* stmt){
+      if(stmt != nullptr) stmt->accept(*this);
+
+      return;
+    }
+
+    void add(const std::vector<Stmt*>& statements){
+      for(Stmt* stmt : statements) add(stmt);
+
+      return;
+    }
+
+  public:
+    static size_t countNodes(Stmt* stmt){
+      NodeCounter counter;
+      counter.add(stmt);
+
+      return counter.count;
+    }
+
+    void visitBlockStmt(Block* stmt) override{ count++; add(stmt->statements); }
+    void visitClassStmt(Class* stmt) override{ count++; add(stmt->superclass); for(Function* method : stmt->methods) add(method); }
+    void visitExpressionStmt(Expression* stmt) override{ count++; add(stmt->expression); }
+    void visitFunctionStmt(Function* stmt) override{ count++; add(stmt->body); }
+    void visitIfStmt(If* stmt) override{ count++; add(stmt->condition); add(stmt->ifBranch); add(stmt->elseBranch); }
+    void visitPrintStmt(Print* stmt) override{ count++; add(stmt->expression); }
+    void visitReturnStmt(Return* stmt) override{ count++; add(stmt->value); }
+    void visitVarStmt(Var* stmt) override{ count++; add(stmt->initializer); }
+    void visitWhileStmt(While* stmt) override{ count++; add(stmt->condition); add(stmt->body); }
+
+    Value visitAssignExpr(Assign* expr) override{ count++; add(expr->value); return {}; }
+    Value visitBinaryExpr(Binary* expr) override{ count++; add(expr->left); add(expr->right); return {}; }
+    Value visitCallExpr(Call* expr) override{ count++; add(expr->callee); for(Expr* argument : expr->arguments) add(argument); return {}; }
+    Value visitGetExpr(Get* expr) override{ count++; add(expr->object); return {}; }
+    Value visitGroupingExpr(Grouping* expr) override{ count++; add(expr->expression); return {}; }
+    Value visitLiteralExpr(Literal*) override{ count++; return {}; }
+    Value visitLogicalExpr(Logical* expr) override{ count++; add(expr->left); add(expr->right); return {}; }
+    Value visitSetExpr(Set* expr) override{ count++; add(expr->object); add(expr->value); return {}; }
+    Value visitSuperExpr(Super*) override{ count++; return {}; }
+    Value visitThisExpr(This*) override{ count++; return {}; }
+    Value visitUnaryExpr(Unary* expr) override{ count++; add(expr->right); return {}; }
+    Value visitVariableExpr(Variable*) override{ count++; return {}; }
+};
+
+// Optimization pass that removes statements that can never run or whose effect can never be observed:
+//   - everything after a statement that always returns (a 'return', or a block or 'if'/'else' whose every path returns),
+//   - the branch of an 'if' whose condition is a literal that never takes it, and 'while' loops whose condition is a falsey literal,
+//   - local variables nothing refers to, when their initializer can't have side effects (or fail),
+//   - local functions nothing refers to, other than their own body (functions that only call each other are kept).
+// Unreferenced declarations come from the Resolver. Removing one moves the slots of the variables declared after it, so the tree
+// has to be resolved again afterwards (and that may leave more declarations unreferenced; see run() in Lox.cpp).
+class DeadCodeEliminator : public StmtVisitor{
+  private:
+    Arena& arena;
+    const std::unordered_set<Stmt*>& unused;
+    size_t removed = 0;   // Nodes of the original tree that are gone. Placeholders put in their place don't count.
+    bool changed = false; // Whether anything was removed or replaced, even by a placeholder of the same size.
+    Stmt* statement = nullptr; // What the statement being visited should be replaced with. Null removes it.
+
+    Stmt* prune(Stmt* stmt){
+      statement = stmt;
+      stmt->accept(*this);
+
+      if(statement != stmt){
+        removed += NodeCounter::countNodes(stmt) - (statement != nullptr ? NodeCounter::countNodes(statement) : 0);
+        changed = true;
+      }
+
+      return statement;
+    }
+
+    void prune(std::vector<Stmt*>& statements){
+      std::vector<Stmt*> kept;
+      kept.reserve(statements.size());
+
+      for(size_t i = 0; i < statements.size(); i++){
+        Stmt* stmt = prune(statements[i]);
+        if(stmt == nullptr) continue;
+
+        kept.push_back(stmt);
+        if(alwaysReturns(stmt)){
+          for(size_t j = i + 1; j < statements.size(); j++){
+            removed += NodeCounter::countNodes(statements[j]);
+            changed = true;
+          }
+          break;
+        }
+      }
+      statements = std::move(kept);
+
+      return;
+    }
+
+    // For statements that can't just disappear, like the body of a loop.
+    Stmt* pruneRequired(Stmt* stmt){
+      Stmt* result = prune(stmt);
+      if(result != nullptr) return result;
+
+      Block* empty = arena.make<Block>(std::vector<Stmt*>{});
+      empty->onStack = true; // No variables, so no Environment either.
+
+      return empty;
+    }
+
+    static bool alwaysReturns(Stmt* stmt){
+      if(dynamic_cast<Return*>(stmt) != nullptr){
+        return true;
+      }
+      if(auto block = dynamic_cast<Block*>(stmt)){
+        return !block->statements.empty() && alwaysReturns(block->statements.back()); // Anything after a return was already removed.
+      }
+      if(auto branch = dynamic_cast<If*>(stmt)){
+        return branch->elseBranch != nullptr && alwaysReturns(branch->ifBranch) && alwaysReturns(branch->elseBranch);
+      }
+
+      return false;
+    }
+
+    // Whether evaluating the expression can neither fail nor change anything. Kept deliberately simple.
+    static bool isPure(Expr* expr){
+      if(expr == nullptr || dynamic_cast<Literal*>(expr) != nullptr || dynamic_cast<This*>(expr) != nullptr){
+        return true;
+      }
+      if(auto variable = dynamic_cast<Variable*>(expr)){
+        return variable->local.onStack || variable->local.depth != -1; // Reading an undefined global is an error.
+      }
+      if(auto grouping = dynamic_cast<Grouping*>(expr)){
+        return isPure(grouping->expression);
+      }
+      if(auto logical = dynamic_cast<Logical*>(expr)){
+        return isPure(logical->left) && isPure(logical->right);
+      }
+      if(auto unary = dynamic_cast<Unary*>(expr)){
+        return unary->op.type == TokenType::BANG && isPure(unary->right);
+      }
+      if(auto binary = dynamic_cast<Binary*>(expr)){
+        bool comparison = binary->op.type == TokenType::EQUAL_EQUAL || binary->op.type == TokenType::BANG_EQUAL;
+        return comparison && isPure(binary->left) && isPure(binary->right);
+      }
+
+      return false;
+    }
+
+  public:
+    DeadCodeEliminator(Arena& arena, const std::unordered_set<Stmt*>& unused)
+      : arena{arena}, unused{unused}
+    {}
+
+    // Returns whether the tree changed, in which case it has to be resolved again.
+    bool eliminate(std::vector<Stmt*>& statements){
+      prune(statements);
+
+      return changed;
+    }
+
+    // How many nodes eliminate() removed (for "--dce-stats").
+    size_t removedNodes() const{
+      return removed;
+    }
+
+    void visitBlockStmt(Block* stmt) override{
+      prune(stmt->statements);
+      statement = stmt;
+
+      return;
+    }
+
+    void visitClassStmt(Class* stmt) override{
+      for(Function* method : stmt->methods){
+        prune(method->body);
+      }
+      statement = stmt;
+
+      return;
+    }
+
+    void visitExpressionStmt(Expression*) override{
+      return;
+    }
+
+    void visitFunctionStmt(Function* stmt) override{
+      if(unused.count(stmt) != 0){
+        statement = nullptr;
+        return;
+      }
+
+      prune(stmt->body);
+      statement = stmt;
+
+      return;
+    }
+
+    void visitIfStmt(If* stmt) override{
+      if(auto condition = dynamic_cast<Literal*>(stmt->condition)){
+        Stmt* branch = Interpreter::isTruthy(condition->value) ? stmt->ifBranch : stmt->elseBranch;
+        statement = branch != nullptr ? prune(branch) : nullptr;
+        return;
+      }
+
+      stmt->ifBranch = pruneRequired(stmt->ifBranch);
+      if(stmt->elseBranch != nullptr){
+        stmt->elseBranch = prune(stmt->elseBranch);
+      }
+      statement = stmt;
+
+      return;
+    }
+
+    void visitPrintStmt(Print*) override{
+      return;
+    }
+
+    void visitReturnStmt(Return*) override{
+      return;
+    }
+
+    void visitVarStmt(Var* stmt) override{
+      if(unused.count(stmt) != 0 && isPure(stmt->initializer)){
+        statement = nullptr;
+      }
+
+      return;
+    }
+
+    void visitWhileStmt(While* stmt) override{
+      auto condition = dynamic_cast<Literal*>(stmt->condition);
+      if(condition != nullptr && !Interpreter::isTruthy(condition->value)){
+        statement = nullptr;
+        return;
+      }
+
+      stmt->body = pruneRequired(stmt->body);
+      statement = stmt;
+
+      return;
+    }
+};
@@ -1,48 +1,144 @@
 #pragma once
 
-#include <any>
-#include <map>
+#include <new>
 #include <memory>
 #include <string>
+#include <vector>
+#include <unordered_map>
 #include <utility>
 #include <functional>
 
 #include "Error.hpp"
 #include "Token.hpp"
-
-class Environment : public std::enable_shared_from_this<Environment>{
+#include "Value.hpp"
+#include "Object.hpp"
+#include "Collector.hpp"
+#include "LoxString.hpp"
+
+// Environments are objects too: closures keep the environment they were created in alive, and since environments hold
+// functions, the two can point at each other. The Collector frees those cycles.
+class Environment : public Object{
   private:
     friend class Interpreter;
+    friend class LoxFunction;
+    friend class VM;
     
-    std::shared_ptr<Environment> enclosing;
-    std::map<std::string, std::any> values;
+    Ref<Environment> enclosing;
+    std::vector<Value> slots; // Local variables, indexed by the slot the Resolver assigned to each of them.
+    std::unordered_map<LoxString*, Value, SymbolHash> values; // Global variables. They are late-bound, so they are still looked up by (interned) name.
+
+    // An environment is created for every call and every block, and unless a closure captured it, it dies as soon as the call
+    // returns or the block ends. Instead of going back to the allocator, its memory and the storage of its slots are kept here
+    // and handed to the next environment. Only the last POOL_LIMIT of each are kept, so a deep recursion doesn't pin its memory forever.
+    struct Pool{
+      static constexpr size_t POOL_LIMIT = 1024;
+
+      std::vector<void*> memory;
+      std::vector<std::vector<Value>> slots;
+
+      ~Pool(){
+        for(void* block : memory){
+          ::operator delete(block);
+        }
+      }
+    };
+
+    static inline Pool pool;
+
+    void reuseSlots(){
+      if(!pool.slots.empty()){
+        slots = std::move(pool.slots.back());
+        pool.slots.pop_back();
+      }
+
+      return;
+    }
 
   public:
     Environment() // Constructor for the Global Environment (There's no enclosing environment).
-      : enclosing{nullptr}
-    {}
+      : Object{Object::Type::ENVIRONMENT}, enclosing{nullptr}
+    {
+      track();
+    }
+
+    Environment(Ref<Environment> enclosing) // Constructor for any non-global Environment that might receive an enclosing environment.
+      : Object{Object::Type::ENVIRONMENT}, enclosing{std::move(enclosing)}
+    {
+      reuseSlots();
+      track();
+    }
+
+    ~Environment(){
+      if(slots.capacity() != 0 && pool.slots.size() < Pool::POOL_LIMIT){
+        slots.clear();
+        pool.slots.push_back(std::move(slots));
+      }
+    }
+
+    static void* operator new(size_t size){
+      if(!pool.memory.empty()){
+        void* block = pool.memory.back();
+        pool.memory.pop_back();
+        return block;
+      }
+
+      return ::operator new(size);
+    }
+
+    static void operator delete(void* block){
+      if(pool.memory.size() < Pool::POOL_LIMIT){
+        pool.memory.push_back(block);
+        return;
+      }
+
+      ::operator delete(block);
+      return;
+    }
 
-    Environment(std::shared_ptr<Environment> enclosing) // Constructor for any non-global Environment that might receive an enclosing environment.
-      : enclosing{std::move(enclosing)}
-    {}
+    std::string toString() override{
+      return "<environment>";
+    }
+
+    void traceReferences(Collector& collector) override{
+      if(enclosing != nullptr) collector.visit(enclosing.get());
+      for(const Value& value : slots) collector.visit(value);
+      for(const auto& [name, value] : values) collector.visit(value);
+
+      return;
+    }
 
-    void define(const std::string& name, std::any value){ // A new variable is always declared in the current innermost scope.
-      values[name] = std::move(value);
+    void clearReferences() override{
+      enclosing = nullptr;
+      slots.clear();
+      values.clear();
 
       return;
     }
 
-    std::shared_ptr<Environment> ancestor(int distance){
-      std::shared_ptr<Environment> environment = shared_from_this();
+    void define(LoxString* name, Value value){ // A new variable is always declared in the current innermost scope.
+      values.insert_or_assign(name, std::move(value));
+
+      return;
+    }
+
+    // Local variables are declared in the same order the Resolver saw them, so the next free slot is always the right one.
+    void define(Value value){
+      slots.push_back(std::move(value));
+
+      return;
+    }
+
+    Environment* ancestor(int distance){
+      Environment* environment = this;
       for(int i = 0; i < distance; i++){
-        environment = environment->enclosing;
+        environment = environment->enclosing.get();
       }
 
       return environment;
     }
 
-    void assign(const Token& name, std::any value){
-      auto elem = values.find(name.lexeme);
+    void assign(const Token& name, Value value){
+      auto elem = values.find(name.symbol);
       if(elem != values.end()){
         elem->second = std::move(value);
         return;
@@ -54,12 +150,13 @@ class Environment : public std::enable_shared_from_this<Environment>{
       }
 
       // If the variable hasn't already been declared (does not exist inside the environment map), then we cannot assign a new value to it.
-      throw RuntimeError(name, "Undefined variable '" + name.lexeme + "'."); 
+      throw RuntimeError(name, "Undefined variable '" + std::string{name.lexeme} + "'."); 
     }
 
-    std::any get(const Token& name){
-      if(values.find(name.lexeme) != values.end()){
-        return values[name.lexeme];
+    Value get(const Token& name){
+      auto elem = values.find(name.symbol);
+      if(elem != values.end()){
+        return elem->second;
       }
 
       if(enclosing != nullptr){ // If a name was not found in the current scope. Try looking for it in the enclosing/outer scope it we reach the Global scope.
@@ -67,16 +164,16 @@ class Environment : public std::enable_shared_from_this<Environment>{
       }
 
       // If the variable hasn't already been declared (does not exist inside the environment map), then we cannot get its value.
-      throw RuntimeError(name, "Undefined variable: '" + name.lexeme + "'.");
+      throw RuntimeError(name, "Undefined variable: '" + std::string{name.lexeme} + "'.");
     }
 
-    void assignAt(int distance, const Token& name, std::any value){
-      ancestor(distance)->values[name.lexeme] = std::move(value);
+    void assignAt(int distance, int slot, Value value){
+      ancestor(distance)->slots[slot] = std::move(value);
 
       return;
     }
 
-    std::any getAt(int distance, const std::string& name){
-      return ancestor(distance)->values[name];
+    const Value& getAt(int distance, int slot){
+      return ancestor(distance)->slots[slot];
     }
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <iostream>
 #include <string_view>
 
@@ -20,7 +21,7 @@ static void error(const Token& token, std::string_view message){
   if(token.type == TokenType::FILE_END){
     report(token.line, " at end ", message);
   }else{
-    report(token.line, " at '" + token.lexeme + "'", message);
+    report(token.line, " at '" + std::string{token.lexeme} + "'", message);
   }
 
   return;
@@ -1,11 +1,12 @@
 #pragma once
 
-#include <any>
 #include <memory>
 #include <vector>
 #include <utility>
 
 #include "Token.hpp"
+#include "Value.hpp"
+#include "PropertyCache.hpp"
 
 struct Assign;
 struct Binary;
@@ -21,178 +22,197 @@ struct Unary;
 struct Variable;
 
 struct ExprVisitor{
-  virtual std::any visitAssignExpr(std::shared_ptr<Assign> expr) = 0;
-  virtual std::any visitBinaryExpr(std::shared_ptr<Binary> expr) = 0;
-  virtual std::any visitCallExpr(std::shared_ptr<Call> expr) = 0;
-  virtual std::any visitGetExpr(std::shared_ptr<Get> expr) = 0;
-  virtual std::any visitGroupingExpr(std::shared_ptr<Grouping> expr) = 0;
-  virtual std::any visitLiteralExpr(std::shared_ptr<Literal> expr) = 0;
-  virtual std::any visitLogicalExpr(std::shared_ptr<Logical> expr) = 0;
-  virtual std::any visitSetExpr(std::shared_ptr<Set> expr) = 0;
-  virtual std::any visitSuperExpr(std::shared_ptr<Super> expr) = 0;
-  virtual std::any visitThisExpr(std::shared_ptr<This> expr) = 0;
-  virtual std::any visitUnaryExpr(std::shared_ptr<Unary> expr) = 0;
-  virtual std::any visitVariableExpr(std::shared_ptr<Variable> expr) = 0;
+  virtual Value visitAssignExpr(Assign* expr) = 0;
+  virtual Value visitBinaryExpr(Binary* expr) = 0;
+  virtual Value visitCallExpr(Call* expr) = 0;
+  virtual Value visitGetExpr(Get* expr) = 0;
+  virtual Value visitGroupingExpr(Grouping* expr) = 0;
+  virtual Value visitLiteralExpr(Literal* expr) = 0;
+  virtual Value visitLogicalExpr(Logical* expr) = 0;
+  virtual Value visitSetExpr(Set* expr) = 0;
+  virtual Value visitSuperExpr(Super* expr) = 0;
+  virtual Value visitThisExpr(This* expr) = 0;
+  virtual Value visitUnaryExpr(Unary* expr) = 0;
+  virtual Value visitVariableExpr(Variable* expr) = 0;
   virtual ~ExprVisitor() = default;
 };
 
 struct Expr{
-  virtual std::any accept(ExprVisitor& visitor) = 0;
+  virtual Value accept(ExprVisitor& visitor) = 0;
 };
 
-struct Assign : Expr, public std::enable_shared_from_this<Assign>{
+// Filled in by the Resolver for expressions that refer to a variable.
+// It tells how many environments up the chain the variable lives and which slot it occupies there.
+// A depth of -1 means the variable wasn't found in any local scope, so it's a global.
+// Variables that no closure can capture don't live in an environment at all, but in the current frame of the value stack:
+// then 'onStack' is set and 'slot' is relative to the start of the frame.
+struct LocalSlot{
+  int depth = -1;
+  int slot = 0;
+  bool onStack = false;
+};
+
+struct Assign : Expr{
   const Token name; // L-value (Evaluates to a location in memory to which we can assign the value to).
-  const std::shared_ptr<Expr> value; // R-value (Expression that evaluates to a value).
+  Expr* value; // R-value (Expression that evaluates to a value).
+  LocalSlot local;
 
-  Assign(Token name, std::shared_ptr<Expr> value)
+  Assign(Token name, Expr* value)
     : name{std::move(name)}, value{std::move(value)}
   {}
 
-  std::any accept(ExprVisitor& visitor) override{
-    return visitor.visitAssignExpr(shared_from_this());
+  Value accept(ExprVisitor& visitor) override{
+    return visitor.visitAssignExpr(this);
   }
 };
 
-struct Binary : Expr, public std::enable_shared_from_this<Binary>{
-  const std::shared_ptr<Expr> left;
+struct Binary : Expr{
+  Expr* left;
   const Token op;
-  const std::shared_ptr<Expr> right;
+  Expr* right;
 
-  Binary(std::shared_ptr<Expr> left, Token op, std::shared_ptr<Expr> right) 
+  Binary(Expr* left, Token op, Expr* right) 
     : left{std::move(left)}, op{std::move(op)}, right{std::move(right)}
   {}
 
-  std::any accept(ExprVisitor& visitor) override{
-    return visitor.visitBinaryExpr(shared_from_this());
+  Value accept(ExprVisitor& visitor) override{
+    return visitor.visitBinaryExpr(this);
   }
 };
 
-struct Call : Expr, public std::enable_shared_from_this<Call>{
-  const std::shared_ptr<Expr> callee;
+struct Call : Expr{
+  Expr* callee;
   const Token paren;
-  const std::vector<std::shared_ptr<Expr>> arguments;
+  std::vector<Expr*> arguments;
+  Get* method = nullptr; // Set by the Parser when the callee is a property access ("object.name(...)"), so the method can be invoked without binding it first.
 
-  Call(std::shared_ptr<Expr> callee, Token paren, std::vector<std::shared_ptr<Expr>> arguments)
+  Call(Expr* callee, Token paren, std::vector<Expr*> arguments)
     : callee{std::move(callee)}, paren{std::move(paren)}, arguments{std::move(arguments)}
   {}
 
-  std::any accept(ExprVisitor& visitor) override{
-    return visitor.visitCallExpr(shared_from_this());
+  Value accept(ExprVisitor& visitor) override{
+    return visitor.visitCallExpr(this);
   }
 };
 
-struct Get : Expr, public std::enable_shared_from_this<Get>{
+struct Get : Expr{
   const Token name;
-  const std::shared_ptr<Expr> object;
+  Expr* object;
+  PropertyCache cache;
 
-  Get(Token name, std::shared_ptr<Expr> object)
+  Get(Token name, Expr* object)
     : name{std::move(name)}, object{std::move(object)}
   {}
 
-  std::any accept(ExprVisitor& visitor) override{
-    return visitor.visitGetExpr(shared_from_this());
+  Value accept(ExprVisitor& visitor) override{
+    return visitor.visitGetExpr(this);
   }
 };
 
-struct Grouping : Expr, std::enable_shared_from_this<Grouping>{
-  const std::shared_ptr<Expr> expression;
+struct Grouping : Expr{
+  Expr* expression;
 
-  Grouping(std::shared_ptr<Expr> expression)
+  Grouping(Expr* expression)
     : expression{std::move(expression)}
   {}
 
-  std::any accept(ExprVisitor& visitor) override{
-    return visitor.visitGroupingExpr(shared_from_this());
+  Value accept(ExprVisitor& visitor) override{
+    return visitor.visitGroupingExpr(this);
   }
 };
 
-struct Literal : Expr, public std::enable_shared_from_this<Literal>{
-  const std::any value;
+struct Literal : Expr{
+  const Value value;
 
-  Literal(std::any value)
+  Literal(Value value)
     : value{std::move(value)}
   {}
 
-  std::any accept(ExprVisitor& visitor) override{
-    return visitor.visitLiteralExpr(shared_from_this());
+  Value accept(ExprVisitor& visitor) override{
+    return visitor.visitLiteralExpr(this);
   }
 };
 
-struct Logical : Expr, public std::enable_shared_from_this<Logical>{
-  const std::shared_ptr<Expr> left;
+struct Logical : Expr{
+  Expr* left;
   const Token op;
-  const std::shared_ptr<Expr> right;
+  Expr* right;
 
-  Logical(std::shared_ptr<Expr> left, Token op, std::shared_ptr<Expr> right)
+  Logical(Expr* left, Token op, Expr* right)
     : left{std::move(left)}, op{std::move(op)}, right{std::move(right)}
   {}
 
-  std::any accept(ExprVisitor& visitor) override{
-    return visitor.visitLogicalExpr(shared_from_this());
+  Value accept(ExprVisitor& visitor) override{
+    return visitor.visitLogicalExpr(this);
   }
 };
 
-struct Set : Expr, public std::enable_shared_from_this<Set>{
-  const std::shared_ptr<Expr> object;
+struct Set : Expr{
+  Expr* object;
   const Token name;
-  const std::shared_ptr<Expr> value;
+  Expr* value;
+  PropertyCache cache;
 
-  Set(std::shared_ptr<Expr> object, Token name, std::shared_ptr<Expr> value)
+  Set(Expr* object, Token name, Expr* value)
     : object{std::move(object)}, name{std::move(name)}, value{std::move(value)}
   {}
 
-  std::any accept(ExprVisitor& visitor) override{
-    return visitor.visitSetExpr(shared_from_this());
+  Value accept(ExprVisitor& visitor) override{
+    return visitor.visitSetExpr(this);
   }
 
 };
 
-struct Super : Expr, public std::enable_shared_from_this<Super>{
+struct Super : Expr{
   const Token keyword;
   const Token method;
+  LocalSlot local;
+  LocalSlot thisLocal; // Where the method's receiver is, which is bound to the superclass method.
 
   Super(Token keyword, Token method)
     : keyword{std::move(keyword)}, method{std::move(method)}
   {}
 
-  std::any accept(ExprVisitor& visitor) override{
-    return visitor.visitSuperExpr(shared_from_this());
+  Value accept(ExprVisitor& visitor) override{
+    return visitor.visitSuperExpr(this);
   }
 };
 
-struct This : Expr, public std::enable_shared_from_this<This>{
+struct This : Expr{
   const Token keyword;
+  LocalSlot local;
 
   This(Token keyword)
     : keyword{std::move(keyword)}
   {}
 
-  std::any accept(ExprVisitor& visitor) override{
-    return visitor.visitThisExpr(shared_from_this());
+  Value accept(ExprVisitor& visitor) override{
+    return visitor.visitThisExpr(this);
   }
 };
 
-struct Unary : Expr, public std::enable_shared_from_this<Unary>{
+struct Unary : Expr{
   const Token op;
-  const std::shared_ptr<Expr> right;
+  Expr* right;
 
-  Unary(Token op, std::shared_ptr<Expr> right)
+  Unary(Token op, Expr* right)
     : op{std::move(op)}, right{std::move(right)} 
   {}
 
-  std::any accept(ExprVisitor& visitor) override{
-    return visitor.visitUnaryExpr(shared_from_this());
+  Value accept(ExprVisitor& visitor) override{
+    return visitor.visitUnaryExpr(this);
   }
 };
 
-struct Variable : Expr, public std::enable_shared_from_this<Variable>{
+struct Variable : Expr{
   const Token name;
+  LocalSlot local;
 
   Variable(Token name)
     : name{std::move(name)}
   {}
 
-  std::any accept(ExprVisitor& visitor) override{
-    return visitor.visitVariableExpr(shared_from_this());  
+  Value accept(ExprVisitor& visitor) override{
+    return visitor.visitVariableExpr(this);  
   }
 };
@@ -1,104 +1,296 @@
 #pragma once
 
-#include <any>
 #include <map>
-#include <chrono>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <cstdint>
 #include <utility>
 #include <iostream>
 #include <stdexcept>
 
 #include "Expr.hpp"
 #include "Stmt.hpp"
+#include "Value.hpp"
 #include "Error.hpp"
+#include "Collector.hpp"
 #include "LoxClass.hpp"
-#include "LoxReturn.hpp"
 #include "Environment.hpp"
 #include "LoxCallable.hpp"
 #include "LoxFunction.hpp"
 #include "LoxInstance.hpp"
+#include "LoxNative.hpp"
+#include "LoxString.hpp"
 #include "RuntimeError.hpp"
 
-class NativeClock : public LoxCallable {
+class VM;
+
+class Interpreter : public ExprVisitor, public StmtVisitor{
+  friend class LoxFunction;
+  friend class VM;
+  friend class ConstantFolder;
+  friend class DeadCodeEliminator;
+  friend class StandardLibrary;
+
   public:
-    int arity() override{
-      return 0;
+    Ref<Environment> globals = makeRef<Environment>();
+    size_t maxCallDepth = 10000; // Calls in progress at once (tail calls don't count), in both engines. Set by "--max-call-depth=N".
+    uintptr_t stackLimit = 0; // Lowest address the native stack may reach before evaluation stops (0 for no limit). See guardNativeStack in Lox.cpp.
+
+    // Whether the native stack has grown past 'stackLimit'. How much of it a call takes depends on how deeply the call is nested
+    // in expressions and blocks, and on the compiler, so the call depth limit alone can't keep it from running out.
+    bool nativeStackExhausted() const{
+      return reinterpret_cast<uintptr_t>(__builtin_frame_address(0)) < stackLimit;
+    }
+
+  private:
+    Ref<Environment> environment = globals;
+
+    // Set by a 'return' statement. Statements stop executing while it's set, until the enclosing function call picks up the value.
+    // This is a lot cheaper than unwinding the C++ stack with an exception on every return.
+    bool returning = false;
+    Value returnValue;
+
+    VM* vm = nullptr; // The VM running the script, if that's the engine in use. Natives that call Lox code run it there.
+
+    // A call in tail position that LoxFunction::invoke still has to make, once the function returning it is done.
+    struct TailCall{
+      Ref<LoxFunction> function;
+      Value receiver;
+      std::vector<Value> arguments;
+    };
+    bool tailCalling = false;
+    TailCall tailCall;
+
+    // Variables that no closure can capture (see Resolver::resolveFunction) live here instead of in Environments.
+    // Every call of a function whose variables are all like that, and every outermost block of them, pushes a frame of the size
+    // the Resolver computed and pops it when it's done, so they never allocate.
+    std::vector<Value> stack;
+    size_t frameBase = 0; // Index of slot 0 of the current frame.
+
+    Value lookUpVariable(const Token& name, const LocalSlot& local){
+      if(local.onStack){
+        return stack[frameBase + local.slot];
+      }else if(local.depth != -1){
+        return environment->getAt(local.depth, local.slot);
+      }else{
+        return globals->get(name);
+      }
     }
 
-    std::any call(Interpreter& interpreter, std::vector<std::any> arguments) override{
-      auto ticks = std::chrono::system_clock::now().time_since_epoch();
-      auto timeElapsedInSecs = std::chrono::duration<double>{ticks}.count() / 1000.0;
+    // Counts the calls in progress. The call that would go past 'maxCallDepth' fails with a runtime error instead.
+    // It's also the call site that reports running out of native stack (see checkNativeStack), until the call ends.
+    struct CallDepth{
+      Interpreter& interpreter;
+      const Token* previousCallSite;
+
+      CallDepth(Interpreter& interpreter, const Token& paren)
+        : interpreter{interpreter}, previousCallSite{interpreter.callSite}
+      {
+        if(interpreter.callDepth >= interpreter.maxCallDepth){
+          throw RuntimeError{paren, "Stack overflow."};
+        }
+        interpreter.callDepth++;
+        interpreter.callSite = &paren;
+      }
+
+      ~CallDepth(){
+        interpreter.callDepth--;
+        interpreter.callSite = previousCallSite;
+      }
+    };
+    size_t callDepth = 0;
+    const Token* callSite = nullptr; // The innermost call in progress.
+    inline static const Token scriptSite{0, TokenType::FILE_END, ""}; // Stands for the call site outside of any call.
+
+    // Every expression and statement is evaluated in a native call (or a few) of its own, so this runs before each of them.
+    void checkNativeStack(){
+      if(nativeStackExhausted()){
+        throw RuntimeError{callSite != nullptr ? *callSite : scriptSite, "Stack overflow."};
+      }
 
-      return timeElapsedInSecs;
+      return;
     }
 
-    std::string toString() override{
-      return "<native fun>";
+    std::vector<Value> evaluateArguments(Call* expr){
+      std::vector<Value> arguments;
+      arguments.reserve(expr->arguments.size());
+      for(Expr* argument : expr->arguments){
+        arguments.push_back(evaluate(argument));
+      }
+
+      return arguments;
     }
-};
 
-class Interpreter : public ExprVisitor, public StmtVisitor{
-  friend class LoxFunction;
+    void checkArity(const Token& paren, LoxCallable* function, size_t argCount){
+      if(argCount != function->arity()){
+        throw RuntimeError{paren, "Expected " + std::to_string(function->arity()) + " arguments, but received " + std::to_string(argCount) + "."};
+      }
 
-  public: std::shared_ptr<Environment> globals{ new Environment };
-  private:
-    std::shared_ptr<Environment> environment = globals;
-    std::map<std::shared_ptr<Expr>, int> locals;
-
-    std::any lookUpVariable(const Token& name, std::shared_ptr<Expr> expr){
-      auto elem = locals.find(expr);
-      if(elem != locals.end()){
-        int distance = elem->second;
-        return environment->getAt(distance, name.lexeme);
+      return;
+    }
+
+    // Evaluates the arguments of the call and calls 'callee' with them.
+    Value callValue(Call* expr, Value callee){
+      std::vector<Value> arguments = evaluateArguments(expr);
+
+      if(!callee.isCallable()){
+        throw RuntimeError{expr->paren, "Can only call functions and classes."};
+      }
+      LoxCallable* function = callee.asObject<LoxCallable>(); // Kept alive by 'callee' for the duration of the call.
+      checkArity(expr->paren, function, arguments.size());
+      CallDepth depth{*this, expr->paren};
+
+      if(callee.isNative()){
+        try{
+          return function->call(*this, std::move(arguments));
+        }catch(const NativeError& error){
+          throw RuntimeError{expr->paren, error.what()};
+        }
+      }
+
+      return function->call(*this, std::move(arguments));
+    }
+
+    void scheduleTailCall(LoxFunction* function, const Value& receiver, std::vector<Value> arguments){
+      tailCall.function = function;
+      tailCall.receiver = receiver;
+      tailCall.arguments = std::move(arguments);
+      tailCalling = true;
+
+      return;
+    }
+
+    TailCall takeTailCall(){
+      TailCall call = std::move(tailCall);
+      tailCall = TailCall{};
+      tailCalling = false;
+
+      return call;
+    }
+
+    // Evaluates the call of "return f(...);" like visitCallExpr does, except that a Lox function isn't called here: it's scheduled
+    // for the enclosing LoxFunction::invoke instead, and the 'return' unwinds the current call first (returning nil for now).
+    // Natives and classes are called right away, as usual.
+    Value evaluateTailCall(Call* expr){
+      Value callee;
+      if(expr->method != nullptr){
+        Value object = evaluate(expr->method->object);
+        if(object.isInstance()){
+          LoxInstance* instance = object.asObject<LoxInstance>();
+          if(instance->findField(expr->method->name, expr->method->cache) == nullptr){
+            LoxFunction* method = instance->findMethod(expr->method->name.symbol);
+            if(method != nullptr){
+              std::vector<Value> arguments = evaluateArguments(expr);
+              checkArity(expr->paren, method, arguments.size());
+              scheduleTailCall(method, object, std::move(arguments));
+
+              return nullptr;
+            }
+          }
+        }
+        callee = getProperty(expr->method, object);
       }else{
-        return globals->get(name);
+        callee = evaluate(expr->callee);
       }
+
+      if(!callee.isFunction()){
+        return callValue(expr, std::move(callee));
+      }
+
+      LoxFunction* function = callee.asObject<LoxFunction>();
+      std::vector<Value> arguments = evaluateArguments(expr);
+      checkArity(expr->paren, function, arguments.size());
+      scheduleTailCall(function, function->receiver, std::move(arguments));
+
+      return nullptr;
     }
 
-    void checkNumberOperand(const Token& op, const std::any& operand){
-      if(operand.type() == typeid(double)) return;
+    // Evaluates the value of a 'return' that can end with a tail call (see Return::isTailCall). Parentheses and the left operand
+    // of 'and'/'or' are evaluated as usual. If the result comes down to the call, it goes through evaluateTailCall.
+    Value evaluateTail(Expr* expr){
+      if(auto grouping = dynamic_cast<Grouping*>(expr)){
+        return evaluateTail(grouping->expression);
+      }
+      if(auto logical = dynamic_cast<Logical*>(expr)){
+        Value left = evaluate(logical->left);
+        if(logical->op.type == TokenType::OR ? isTruthy(left) : !isTruthy(left)){
+          return left;
+        }
+
+        return evaluateTail(logical->right);
+      }
+
+      return evaluateTailCall(static_cast<Call*>(expr));
+    }
+
+    Value getProperty(Get* expr, const Value& object){
+      if(object.isInstance()){
+        return object.asObject<LoxInstance>()->get(expr->name, expr->cache);
+      }
+
+      throw RuntimeError(expr->name, "Only instances have properties.");
+    }
+
+    // Declares a variable in the innermost scope. Only globals are still stored by name.
+    void declare(const Token& name, Value value){
+      if(environment == globals){
+        globals->define(name.symbol, std::move(value));
+      }else{
+        environment->define(std::move(value));
+      }
+
+      return;
+    }
+
+    void checkNumberOperand(const Token& op, const Value& operand){
+      if(operand.isNumber()) return;
       throw RuntimeError{op, "Operand must be a number."};
     }
 
-    void checkNumberOperands(const Token& op, const std::any& left, const std::any& right){
-      if(left.type() == typeid(double) && right.type() == typeid(double)) return;
+    void checkNumberOperands(const Token& op, const Value& left, const Value& right){
+      if(left.isNumber() && right.isNumber()) return;
       throw RuntimeError{op, "Operands must be both numbers"};
     }
 
-    bool isTruthy(const std::any& object){
-      if(object.type() == typeid(nullptr)) return false;
-      if(object.type() == typeid(bool)) return std::any_cast<bool>(object);
+    static bool isTruthy(const Value& object){
+      if(object.isNil()) return false;
+      if(object.isBool()) return object.asBool();
       return true;
     }
 
-    bool isEqual(const std::any& a, const std::any& b){
-      if(a.type() == typeid(nullptr) && b.type() == typeid(nullptr)){
-        return true;
-      }
-      if(a.type() == typeid(nullptr)){
+    static bool isEqual(const Value& a, const Value& b){
+      if(a.getType() != b.getType()){
         return false;
       }
 
-      if(a.type() == typeid(std::string) && b.type() == typeid(std::string)){
-        return std::any_cast<std::string>(a) == std::any_cast<std::string>(b);
-      }
-      if(a.type() == typeid(double) && b.type() == typeid(double)){
-        return std::any_cast<double>(a) == std::any_cast<double>(b);
-      }
-      if(a.type() == typeid(bool) && b.type() == typeid(bool)){
-        return std::any_cast<bool>(a) == std::any_cast<bool>(b);
+      switch(a.getType()){
+        case Value::Type::NIL:
+          return true;
+        case Value::Type::BOOL:
+          return a.asBool() == b.asBool();
+        case Value::Type::NUMBER:
+          return a.asNumber() == b.asNumber();
+        case Value::Type::OBJECT:
+          if(a.isString() && b.isString()){
+            LoxString* left = a.asObject<LoxString>();
+            LoxString* right = b.asObject<LoxString>();
+            if(left == right) return true;
+            if(left->interned && right->interned) return false; // Two different symbols never have the same characters.
+            return left->chars() == right->chars();
+          }
+          return a.asObject() == b.asObject(); // Any other object is only equal to itself.
       }
 
       return false;
     }
 
-    std::string stringify(const std::any& object){
-      if(object.type() == typeid(nullptr)) return "nil";
+    std::string stringify(const Value& object){
+      if(object.isNil()) return "nil";
 
-      if(object.type() == typeid(double)){
-        std::string text = std::to_string(std::any_cast<double>(object));
+      if(object.isNumber()){
+        std::string text = std::to_string(object.asNumber());
         int textLength = text.length();
 
         if(text[textLength - 2] == '.' && text[textLength - 1] == '0'){
@@ -108,178 +300,224 @@ class Interpreter : public ExprVisitor, public StmtVisitor{
         return text;
       }
 
-      if(object.type() == typeid(std::string)) return std::any_cast<std::string>(object);
-
-      if(object.type() == typeid(bool)){
-        return std::any_cast<bool>(object) ? "true" : "false";
-      }
-
-      if(object.type() == typeid(std::shared_ptr<LoxFunction>)){
-        return std::any_cast<std::shared_ptr<LoxFunction>>(object)->toString();
-      }
-
-      if(object.type() == typeid(std::shared_ptr<LoxClass>)){
-        return std::any_cast<std::shared_ptr<LoxClass>>(object)->toString();
-      }
-
-      if(object.type() == typeid(std::shared_ptr<LoxInstance>)){
-        return std::any_cast<std::shared_ptr<LoxInstance>>(object)->toString();
+      if(object.isBool()){
+        return object.asBool() ? "true" : "false";
       }
 
-      return "Error in stringify: object type not recognized.";
+      // Strings, functions, classes and instances all know how to print themselves.
+      return object.asObject()->toString();
     }
 
-    std::any evaluate(std::shared_ptr<Expr> expr){
+    Value evaluate(Expr* expr){
+      checkNativeStack();
       return expr->accept(*this);
     }
 
-    void execute(std::shared_ptr<Stmt> stmt){
+    void execute(Stmt* stmt){
+      checkNativeStack();
       stmt->accept(*this);
       
       return;
     }
 
-    void executeBlock(const std::vector<std::shared_ptr<Stmt>>& statements, std::shared_ptr<Environment> environment){
-      std::shared_ptr<Environment> previous = this->environment;
+    // Puts the enclosing environment back when a block is left, whether it ends normally, returns or throws a runtime error.
+    struct EnvironmentScope{
+      Interpreter& interpreter;
+      Ref<Environment> previous;
 
-      try{
-        this->environment = environment;
-        for(const std::shared_ptr<Stmt>& statement : statements){
-          execute(statement);
-        }
-      }catch(...){
-        this->environment = previous;
-        throw;
+      EnvironmentScope(Interpreter& interpreter, Ref<Environment> environment)
+        : interpreter{interpreter}, previous{std::move(interpreter.environment)}
+      {
+        interpreter.environment = std::move(environment);
+      }
+
+      ~EnvironmentScope(){
+        interpreter.environment = std::move(previous);
       }
+    };
 
-      this->environment = previous;
+    // Pushes a frame of 'size' slots on the value stack, and pops it when the block or call that needed it ends (however it ends).
+    struct StackFrame{
+      Interpreter& interpreter;
+      size_t previousBase;
+
+      StackFrame(Interpreter& interpreter, int size)
+        : interpreter{interpreter}, previousBase{interpreter.frameBase}
+      {
+        interpreter.frameBase = interpreter.stack.size();
+        interpreter.stack.resize(interpreter.frameBase + size);
+      }
+
+      ~StackFrame(){
+        interpreter.stack.resize(interpreter.frameBase);
+        interpreter.frameBase = previousBase;
+      }
+    };
+
+    void executeStatements(const std::vector<Stmt*>& statements){
+      for(Stmt* statement : statements){
+        execute(statement);
+        if(returning) break; // A 'return' skips the rest of every enclosing block, up to the function call.
+      }
 
       return;
     }
+
+    void executeBlock(const std::vector<Stmt*>& statements, Ref<Environment> environment){
+      EnvironmentScope scope{*this, std::move(environment)};
+      executeStatements(statements);
+
+      return;
+    }
+
+    // Hands the value of the 'return' that just finished a function body to the call, and clears the signal.
+    Value finishReturn(){
+      Value value = std::move(returnValue);
+      returnValue = nullptr;
+      returning = false;
+
+      return value;
+    }
   
   public:
-    Interpreter(){
-      globals->define("clock", std::shared_ptr<NativeClock>{});
-    }
+    // Binds a function implemented in C++ to a global name, where scripts (on either engine) can call it like any other.
+    void defineNative(std::string_view name, int arity, LoxNative::Implementation implementation){
+      globals->define(intern(name), makeRef<LoxNative>(arity, implementation));
 
-    void resolve(std::shared_ptr<Expr> expr, int depth){
-      locals[expr] = depth;
       return;
     }
 
-    std::any visitBlockStmt(std::shared_ptr<Block> stmt) override{
-      executeBlock(stmt->statements, std::make_shared<Environment>(environment));
+    void visitBlockStmt(Block* stmt) override{
+      if(!stmt->onStack){
+        executeBlock(stmt->statements, makeRef<Environment>(environment));
+      }else if(stmt->frameSize > 0){
+        StackFrame frame{*this, stmt->frameSize};
+        executeStatements(stmt->statements);
+      }else{
+        executeStatements(stmt->statements); // Its variables (if any) already have slots in the current frame.
+      }
 
-      return {};
+      return;
     }
 
-    std::any visitClassStmt(std::shared_ptr<Class> stmt) override{
-      std::any superclass;
+    void visitClassStmt(Class* stmt) override{
+      Value superclass;
       if(stmt->superclass != nullptr){
         superclass = evaluate(stmt->superclass);
-        if(superclass.type() != typeid(std::shared_ptr<LoxClass>)){
+        if(!superclass.isClass()){
           throw RuntimeError(stmt->superclass->name, "SuperClass must also be a class.");
         }
       }
 
-      environment->define(stmt->name.lexeme, nullptr);
-
       if(stmt->superclass != nullptr){
-        environment = std::make_shared<Environment>(environment);
-        environment->define("super", superclass);
+        environment = makeRef<Environment>(environment);
+        environment->define(superclass);
       }
       
-      std::map<std::string, std::shared_ptr<LoxFunction>> methods;
-      for(std::shared_ptr<Function> method : stmt->methods){
-        auto function = std::make_shared<LoxFunction>(method, environment, method->name.lexeme == "init");
-        methods[method->name.lexeme] = function;
+      LoxClass::MethodTable methods;
+      for(Function* method : stmt->methods){
+        auto function = makeRef<LoxFunction>(method, environment, method->name.lexeme == "init");
+        methods[method->name.symbol] = function;
       }
 
-      std::shared_ptr<LoxClass> superklass = nullptr;
-      if(superclass.type() == typeid(std::shared_ptr<LoxClass>)){
-        superklass = std::any_cast<std::shared_ptr<LoxClass>>(superclass);
+      Ref<LoxClass> superklass = nullptr;
+      if(superclass.isClass()){
+        superklass = superclass.asObject<LoxClass>();
       }
-      auto klass = std::make_shared<LoxClass>(stmt->name.lexeme, superklass, methods);
+      auto klass = makeRef<LoxClass>(std::string{stmt->name.lexeme}, superklass, std::move(methods));
 
       if(superklass != nullptr){
         environment = environment->enclosing;
       }
 
-      environment->assign(stmt->name, std::move(klass));
+      // The class is only bound to its name once it's complete. Its methods look the name up when they run, not when they're created.
+      declare(stmt->name, std::move(klass));
 
-      return {};
+      return;
     }
 
-    std::any visitExpressionStmt(std::shared_ptr<Expression> stmt) override{
+    void visitExpressionStmt(Expression* stmt) override{
       evaluate(stmt->expression);
 
-      return {};
+      return;
     }
 
-    std::any visitFunctionStmt(std::shared_ptr<Function> stmt) override{
+    void visitFunctionStmt(Function* stmt) override{
       // This is the environment that is active when the function is declared not when it’s called, which is what we want.
       // It represents the lexical scope surrounding the function declaration.
       // Finally, when we call the function, we use that environment as the call’s parent instead of going straight to globals.
-      auto function = std::make_shared<LoxFunction>(stmt, environment, false);
-      environment->define(stmt->name.lexeme, function);
+      auto function = makeRef<LoxFunction>(stmt, environment, false);
+      declare(stmt->name, std::move(function));
 
-      return {};
+      return;
     }
 
-    std::any visitIfStmt(std::shared_ptr<If> stmt) override{
+    void visitIfStmt(If* stmt) override{
       if(isTruthy(evaluate(stmt->condition))){
         execute(stmt->ifBranch);
       }else if(stmt->elseBranch != nullptr){
         execute(stmt->elseBranch);
       }
 
-      return {};
+      return;
     }
 
-    std::any visitPrintStmt(std::shared_ptr<Print> stmt) override{
-      std::any expr = evaluate(stmt->expression);
+    void visitPrintStmt(Print* stmt) override{
+      Value expr = evaluate(stmt->expression);
       std::cout << stringify(expr) << std::endl;
-      return {};
+      return;
     }
 
-    std::any visitReturnStmt(std::shared_ptr<Return> stmt) override{
-      std::any value = nullptr;
+    void visitReturnStmt(Return* stmt) override{
+      Value value = nullptr;
 
-      if(stmt->value != nullptr){
+      if(stmt->tailCall){
+        value = evaluateTail(stmt->value);
+      }else if(stmt->value != nullptr){
         value = evaluate(stmt->value);
       }
 
-      throw LoxReturn{value};
+      returnValue = std::move(value);
+      returning = true;
+
+      return;
     }
 
-    std::any visitVarStmt(std::shared_ptr<Var> stmt) override{
+    void visitVarStmt(Var* stmt) override{
       // We assume that the variable declaration statement doesn't assign any value to the variable: "var a;"
       // In this approach, the default declared variable without an initializer has the "nil" value.
-      std::any value = nullptr;
+      Value value = nullptr;
       if(stmt->initializer != nullptr){ // We have a value to assign to the variable that's being declared: "var a = 5;"
         value = evaluate(stmt->initializer);
       }
 
-      environment->define(stmt->name.lexeme, std::move(value));
+      if(stmt->local.onStack){
+        stack[frameBase + stmt->local.slot] = std::move(value);
+      }else{
+        declare(stmt->name, std::move(value));
+      }
 
-      return {};
+      return;
     }
 
-    std::any visitWhileStmt(std::shared_ptr<While> stmt) override{
+    void visitWhileStmt(While* stmt) override{
       while(isTruthy(evaluate(stmt->condition))){
         execute(stmt->body);
+        if(returning) break;
+
+        Collector::instance().collectIfNeeded(); // Loop iterations are safe points, like calls.
       }
 
-      return {};
+      return;
     }
 
-    std::any visitAssignExpr(std::shared_ptr<Assign> expr) override{
-      std::any value = evaluate(expr->value);
+    Value visitAssignExpr(Assign* expr) override{
+      Value value = evaluate(expr->value);
       
-      auto elem = locals.find(expr);
-      if(elem != locals.end()){
-        int distance = elem->second;
-        environment->assignAt(distance, expr->name, value);
+      if(expr->local.onStack){
+        stack[frameBase + expr->local.slot] = value;
+      }else if(expr->local.depth != -1){
+        environment->assignAt(expr->local.depth, expr->local.slot, value);
       }else{
         globals->assign(expr->name, value);
       }
@@ -287,41 +525,41 @@ class Interpreter : public ExprVisitor, public StmtVisitor{
       return value;
     }
 
-    std::any visitBinaryExpr(std::shared_ptr<Binary> expr) override{
-      std::any left = evaluate(expr->left);
-      std::any right = evaluate(expr->right);
+    Value visitBinaryExpr(Binary* expr) override{
+      Value left = evaluate(expr->left);
+      Value right = evaluate(expr->right);
 
       switch(expr->op.type){
         case TokenType::PLUS:
-          if(left.type() == typeid(double) && right.type() == typeid(double)){
-            return std::any_cast<double>(left) + std::any_cast<double>(right);
+          if(left.isNumber() && right.isNumber()){
+            return left.asNumber() + right.asNumber();
           }
-          if(left.type() == typeid(std::string) && right.type() == typeid(std::string)){
-            return std::any_cast<std::string>(left) + std::any_cast<std::string>(right);
+          if(left.isString() && right.isString()){
+            return Value{LoxString::concatenate(left.asObject<LoxString>(), right.asObject<LoxString>())};
           }
 
           throw RuntimeError{expr->op, "Operands must be either two numbers or two strings."};
         case TokenType::MINUS:
           checkNumberOperands(expr->op, left, right);
-          return std::any_cast<double>(left) - std::any_cast<double>(right);
+          return left.asNumber() - right.asNumber();
         case TokenType::STAR:
           checkNumberOperands(expr->op, left, right);
-          return std::any_cast<double>(left) * std::any_cast<double>(right);
+          return left.asNumber() * right.asNumber();
         case TokenType::SLASH:
           checkNumberOperands(expr->op, left, right);
-          return std::any_cast<double>(left) / std::any_cast<double>(right);
+          return left.asNumber() / right.asNumber();
         case TokenType::GREATER:
           checkNumberOperands(expr->op, left, right);
-          return std::any_cast<double>(left) > std::any_cast<double>(right);
+          return left.asNumber() > right.asNumber();
         case TokenType::GREATER_EQUAL:
           checkNumberOperands(expr->op, left, right);
-          return std::any_cast<double>(left) >= std::any_cast<double>(right);
+          return left.asNumber() >= right.asNumber();
         case TokenType::LESS:
           checkNumberOperands(expr->op, left, right);
-          return std::any_cast<double>(left) < std::any_cast<double>(right);
+          return left.asNumber() < right.asNumber();
         case TokenType::LESS_EQUAL:
           checkNumberOperands(expr->op, left, right);
-          return std::any_cast<double>(left) <= std::any_cast<double>(right);
+          return left.asNumber() <= right.asNumber();
         case TokenType::BANG_EQUAL:
           return !isEqual(left, right);
         case TokenType::EQUAL_EQUAL:
@@ -332,52 +570,46 @@ class Interpreter : public ExprVisitor, public StmtVisitor{
       return {};
     }
 
-    std::any visitCallExpr(std::shared_ptr<Call> expr) override{
-      // We need to verify whether the callee is valid or not (This is done through evaluation).
-      std::any callee = evaluate(expr->callee);
-
-      std::vector<std::any> arguments;
-      for(const std::shared_ptr<Expr>& argument : expr->arguments){
-        arguments.push_back(evaluate(argument));
-      }
-
-      // Pointers in a std::any wrapper must be unwrapped before they can be cast
-      std::shared_ptr<LoxCallable> function;
-
-      if(callee.type() == typeid(std::shared_ptr<LoxFunction>)){
-        function = std::any_cast<std::shared_ptr<LoxFunction>>(callee);
-      }else if(callee.type() == typeid(std::shared_ptr<LoxClass>)){
-        function = std::any_cast<std::shared_ptr<LoxClass>>(callee);
-      }else{
-        throw RuntimeError{expr->paren, "Can only call functions and classes."};
-      }
+    Value visitCallExpr(Call* expr) override{
+      if(expr->method != nullptr){
+        // "object.name(...)": if 'name' is a method, call it with 'object' as the receiver instead of binding it first.
+        Value object = evaluate(expr->method->object);
+        if(object.isInstance()){
+          LoxInstance* instance = object.asObject<LoxInstance>();
+          if(instance->findField(expr->method->name, expr->method->cache) == nullptr){
+            LoxFunction* method = instance->findMethod(expr->method->name.symbol);
+            if(method != nullptr){
+              std::vector<Value> arguments = evaluateArguments(expr);
+              checkArity(expr->paren, method, arguments.size());
+              CallDepth depth{*this, expr->paren};
+
+              return method->invoke(*this, object, std::move(arguments));
+            }
+          }
+        }
 
-      if(arguments.size() != function->arity()){
-        throw RuntimeError{expr->paren, "Expected " + std::to_string(function->arity()) + " arguments, but received " + std::to_string(arguments.size()) + "."};
+        // A field (or an error): evaluate the property as usual, without evaluating the object again.
+        return callValue(expr, getProperty(expr->method, object));
       }
 
-      return function->call(*this, std::move(arguments));
+      // We need to verify whether the callee is valid or not (This is done through evaluation).
+      return callValue(expr, evaluate(expr->callee));
     }
 
-    std::any visitGetExpr(std::shared_ptr<Get> expr) override{
-      std::any object = evaluate(expr->object);
-      if(object.type() == typeid(std::shared_ptr<LoxInstance>)){
-        return std::any_cast<std::shared_ptr<LoxInstance>>(object)->get(expr->name);
-      }
-
-      throw RuntimeError(expr->name, "Only instances have properties.");
+    Value visitGetExpr(Get* expr) override{
+      return getProperty(expr, evaluate(expr->object));
     }
 
-    std::any visitGroupingExpr(std::shared_ptr<Grouping> expr) override{
+    Value visitGroupingExpr(Grouping* expr) override{
       return evaluate(expr->expression);
     }
 
-    std::any visitLiteralExpr(std::shared_ptr<Literal> expr) override{
+    Value visitLiteralExpr(Literal* expr) override{
       return expr->value;
     }
 
-    std::any visitLogicalExpr(std::shared_ptr<Logical> expr) override{
-      std::any left = evaluate(expr->left);
+    Value visitLogicalExpr(Logical* expr) override{
+      Value left = evaluate(expr->left);
 
       if(expr->op.type == TokenType::OR){
         if(isTruthy(left)) return left; // Short-Circuit from left to right (left-associative).
@@ -388,58 +620,58 @@ class Interpreter : public ExprVisitor, public StmtVisitor{
       return evaluate(expr->right);
     }
 
-    std::any visitSetExpr(std::shared_ptr<Set> expr) override{
-      std::any object = evaluate(expr->object);
+    Value visitSetExpr(Set* expr) override{
+      Value object = evaluate(expr->object);
 
-      if(object.type() != typeid(std::shared_ptr<LoxInstance>)){
+      if(!object.isInstance()){
         throw RuntimeError(expr->name, "Only instances have fields.");
       }
 
-      std::any value = evaluate(expr->value);
-      std::any_cast<std::shared_ptr<LoxInstance>>(object)->set(expr->name, value);
+      Value value = evaluate(expr->value);
+      object.asObject<LoxInstance>()->set(expr->name, value, expr->cache);
 
       return value;
     }
 
-    std::any visitSuperExpr(std::shared_ptr<Super> expr) override{
-      int distance = locals[expr];
-      auto superclass = std::any_cast<std::shared_ptr<LoxClass>>(environment->getAt(distance, "super"));
-      auto object = std::any_cast<std::shared_ptr<LoxInstance>>(environment->getAt(distance - 1, "this"));
-      std::shared_ptr<LoxFunction> method = superclass->findMethod(expr->method.lexeme);
+    Value visitSuperExpr(Super* expr) override{
+      int distance = expr->local.depth;
+      Value superclass = environment->getAt(distance, 0); // 'super' is the only variable of its scope.
+      Value object = lookUpVariable(expr->keyword, expr->thisLocal);
+      Ref<LoxFunction> method = superclass.asObject<LoxClass>()->findMethod(expr->method.symbol);
 
       if(method == nullptr){
-        throw RuntimeError(expr->method, "Undefined property '" + expr->method.lexeme + "'.");
+        throw RuntimeError(expr->method, "Undefined property '" + std::string{expr->method.lexeme} + "'.");
       }
 
-      return method->bind(object);
+      return method->bind(object.asObject<LoxInstance>());
     }
 
-    std::any visitThisExpr(std::shared_ptr<This> expr) override{
-      return lookUpVariable(expr->keyword, expr);
+    Value visitThisExpr(This* expr) override{
+      return lookUpVariable(expr->keyword, expr->local);
     }
 
-    std::any visitUnaryExpr(std::shared_ptr<Unary> expr) override{
-      std::any right = evaluate(expr->right);
+    Value visitUnaryExpr(Unary* expr) override{
+      Value right = evaluate(expr->right);
 
       switch(expr->op.type){
         case TokenType::BANG:
           return !isTruthy(right);
         case TokenType::MINUS:
           checkNumberOperand(expr->op, right);
-          return -std::any_cast<double>(right);
+          return -right.asNumber();
       }
 
       // Unreachable
       return {};
     }
 
-    std::any visitVariableExpr(std::shared_ptr<Variable> expr) override{
-      return lookUpVariable(expr->name, expr);
+    Value visitVariableExpr(Variable* expr) override{
+      return lookUpVariable(expr->name, expr->local);
     }
 
-    void interpret(const std::vector<std::shared_ptr<Stmt>>& statements){
+    void interpret(const std::vector<Stmt*>& statements){
       try{
-        for(const std::shared_ptr<Stmt>& statement : statements){
+        for(Stmt* statement : statements){
           execute(statement);
         }
       }catch(RuntimeError error){
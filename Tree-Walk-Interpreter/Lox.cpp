@@ -1,15 +1,29 @@
+#include <memory>
 #include <string>
 #include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstdlib> // std::atexit
 #include <cstring> // std::strerror
-#include <fstream> 
+#include <charconv>
 #include <iostream> // std::getline
+#include <algorithm>
+#include <functional>
+#include <pthread.h>
 
 #include "Error.hpp"
 #include "Parser.hpp"
 #include "Scanner.hpp"
 #include "Resolver.hpp"
+#include "ConstantFolder.hpp"
+#include "DeadCodeEliminator.hpp"
 #include "AstPrinter.hpp"
 #include "Interpreter.hpp"
+#include "StandardLibrary.hpp"
+#include "VM.hpp"
+#include "Collector.hpp"
+#include "SourceBuffer.hpp"
+#include "CompilationUnit.hpp"
 
 // It's not good practice to include .cpp files, but in our case it
 // allows us to lay out the files similarly to the Java code while
@@ -19,62 +33,179 @@
 #include "LoxInstance.cpp" // Chapter 12 - Classes
 
 Interpreter interpreter{}; 
+VM vm{interpreter};
+bool useVM = false; // Set by the "--vm" flag: run scripts on the bytecode VM instead of walking the AST.
+bool foldConstants = true; // Cleared by the "--no-fold" flag.
+bool eliminateDeadCode = true; // Cleared by the "--no-dce" flag.
+bool dceStats = false; // Set by the "--dce-stats" flag: report how many nodes dead code elimination removed.
 
-std::string readFile(std::string_view path) {
-  std::ifstream file{path.data(), std::ios::in | std::ios::binary | std::ios::ate};
-  if(!file){
+// Functions declared in earlier prompt lines keep pointing into their trees, so every unit is kept until the program ends.
+std::vector<std::unique_ptr<CompilationUnit>> compilationUnits;
+
+SourceBuffer readFile(std::string_view path) {
+  SourceBuffer source;
+  if(!source.load(path.data())){
     std::cerr << "Failed to open file " << path << ": " << std::strerror(errno) << "\n";
     std::exit(74);
   }
 
-  std::string contents;
-  contents.resize(file.tellg());
+  return source;
+}
+
+// The tree-walker recurses natively for every Lox call: about a kilobyte of native stack each, a lot more when the call is nested
+// in other expressions and blocks. So instead of running on the main thread, whose stack is whatever 'ulimit -s' gives it, the
+// whole session (every line of the REPL included) runs on a thread of its own, created once, with a stack sized for the call
+// depth limit. The VM only recurses natively when a native function calls back into Lox (like benchmark() does), but it gets
+// the same stack. Whatever the size, the stack is guarded: evaluation stops with a "Stack overflow." runtime error a little
+// before it runs out.
+constexpr size_t NATIVE_STACK_PER_CALL = 16 * 1024;
+
+#if defined(__SANITIZE_ADDRESS__) // GCC
+#define ADDRESS_SANITIZER
+#elif defined(__has_feature)      // Clang
+#if __has_feature(address_sanitizer)
+#define ADDRESS_SANITIZER
+#endif
+#endif
+
+#ifdef ADDRESS_SANITIZER
+// AddressSanitizer makes every frame several times larger, and only cleans up the stack after an exception thrown at most 64 MB
+// below its top. So sanitized builds keep a larger reserve, on a stack that never gets past that.
+constexpr size_t NATIVE_STACK_RESERVE = 2 * 1024 * 1024;
+constexpr size_t NATIVE_STACK_MAX = 60 * 1024 * 1024;
+#else
+constexpr size_t NATIVE_STACK_RESERVE = 256 * 1024; // Left for what runs between two checks, and for reporting the error.
+constexpr size_t NATIVE_STACK_MAX = SIZE_MAX;
+#endif
+
+// Sets the interpreter's stack limit from the bounds of the stack of the calling thread.
+void guardNativeStack(){
+  pthread_attr_t attributes;
+  if(pthread_getattr_np(pthread_self(), &attributes) != 0){
+    return;
+  }
 
-  file.seekg(0, std::ios::beg);
-  file.read(contents.data(), contents.size());
+  void* lowest;
+  size_t size;
+  if(pthread_attr_getstack(&attributes, &lowest, &size) == 0 && size > 2 * NATIVE_STACK_RESERVE){
+    interpreter.stackLimit = reinterpret_cast<uintptr_t>(lowest) + NATIVE_STACK_RESERVE;
+  }
+  pthread_attr_destroy(&attributes);
 
-  return contents;
+  return;
 }
 
-void run(std::string_view source){
-  Scanner scanner{source};
-  std::vector<Token> tokens = scanner.scanTokens();
+void interpret(const std::vector<Stmt*>& statements){
+  if(useVM){
+    vm.interpret(statements);
+  }else{
+    interpreter.interpret(statements);
+  }
+
+  return;
+}
+
+// Runs 'session' on a thread with a stack sized for the call depth limit, waits for it to finish and returns its exit status.
+// If the system can't provide a stack that large, it settles for a smaller one, down to running on the main thread: a smaller
+// stack only means recursion reports a stack overflow sooner. The session doesn't exit by itself, so the process only ends on
+// the main thread, once nothing else is running.
+int runOnOwnStack(const std::function<int()>& session){
+  struct Job{
+    const std::function<int()>& session;
+    int status;
+  };
+  Job job{session, 0};
+
+  auto body = [](void* job) -> void*{
+    guardNativeStack();
+    static_cast<Job*>(job)->status = static_cast<Job*>(job)->session();
+    return nullptr;
+  };
+
+  size_t stackSize = std::min((interpreter.maxCallDepth + 64) * NATIVE_STACK_PER_CALL, NATIVE_STACK_MAX);
+  for(; stackSize >= 4 * NATIVE_STACK_RESERVE; stackSize /= 2){
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, std::max<size_t>(stackSize, PTHREAD_STACK_MIN));
+
+    pthread_t thread;
+    int error = pthread_create(&thread, &attributes, body, &job);
+    pthread_attr_destroy(&attributes);
+    if(error == 0){
+      pthread_join(thread, nullptr);
+      return job.status;
+    }
+  }
+
+  body(&job);
+
+  return job.status;
+}
 
-  // for(const Token& token : tokens){
+void run(SourceBuffer source){
+  CompilationUnit& unit = *compilationUnits.emplace_back(std::make_unique<CompilationUnit>());
+  unit.source = std::move(source);
+
+  // for(const Token& token : Scanner{unit.source.view()}.scanTokens()){
   //   std::cout << token.toString() << std::endl;
   // }
 
-  Parser parser{tokens};
-  std::vector<std::shared_ptr<Stmt>> statements = parser.parse();
+  // The parser pulls tokens from the scanner as it goes, so the whole token sequence never exists at once.
+  Scanner scanner{unit.source.view()};
+  Parser parser{scanner, unit.arena};
+  unit.statements = parser.parse();
+  const std::vector<Stmt*>& statements = unit.statements;
 
   if(hadError) return;
 
   // std::cout << AstPrinter{}.print(expression) << std::endl;
 
-  Resolver resolver{interpreter};
+  Resolver resolver{};
   resolver.resolve(statements);
 
   // Stop if there was a resolution error.
   if (hadError) return;
 
-  interpreter.interpret(statements);
+  if(foldConstants){
+    ConstantFolder{unit.arena}.optimize(unit.statements);
+  }
+
+  if(eliminateDeadCode){
+    // Removing declarations moves the slots of the variables declared after them, so the tree is resolved again after every round.
+    // That can leave more declarations unreferenced (the ones only the removed code used), hence the loop.
+    size_t total = 0;
+    for(;;){
+      DeadCodeEliminator eliminator{unit.arena, resolver.unusedDeclarations()};
+      if(!eliminator.eliminate(unit.statements)) break;
+
+      total += eliminator.removedNodes();
+      resolver = Resolver{};
+      resolver.resolve(statements);
+    }
+
+    if(dceStats){
+      std::cerr << "[dce] removed " << total << " nodes." << std::endl;
+    }
+  }
+
+  interpret(statements);
 
   return;
 }
 
-void runFile(std::string_view path){
-  std::string contents = readFile(path);
-  run(contents);
+// Returns the exit status for the script.
+int runFile(SourceBuffer source){
+  run(std::move(source));
     
   if(hadError){
-    std::exit(65);
+    return 65;
   }
 
   if(hadRuntimeError){
-    std::exit(70);
+    return 70;
   }
 
-  return;
+  return 0;
 }
 
 void runPrompt(){
@@ -84,7 +215,7 @@ void runPrompt(){
     if(!std::getline(std::cin, line_of_code)){
       break;
     }
-    run(line_of_code);
+    run(SourceBuffer{std::move(line_of_code)});
         
     hadError = false;
   }
@@ -92,13 +223,63 @@ void runPrompt(){
   return;
 }
 
+// Parses the value of a "--name=value" flag. Exits with a usage error if it isn't a number.
+template<class Number>
+Number flagValue(std::string_view argument){
+  std::string_view text = argument.substr(argument.find('=') + 1);
+  Number value{};
+  auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+  if(error != std::errc{} || end != text.data() + text.size()){
+    std::cout << "Error! Invalid value in '" << argument << "'." << std::endl;
+    std::exit(64);
+  }
+
+  return value;
+}
+
 int main(int argc, char* argv[]){ 
-  if(argc == 1){
-    runPrompt();
-  }else if(argc == 2){
-    runFile(std::string_view(argv[1]));
+  size_t gcThreshold = 10000; // Tracked objects alive before the first collection.
+  double gcGrowth = 2.0;      // After a collection, the next one happens once the survivors have grown this many times.
+  bool gcStats = false;
+
+  std::vector<std::string_view> arguments;
+  for(int i = 1; i < argc; i++){
+    std::string_view argument{argv[i]};
+    if(argument == "--vm"){
+      useVM = true;
+    }else if(argument.substr(0, 15) == "--gc-threshold="){
+      gcThreshold = flagValue<size_t>(argument);
+    }else if(argument.substr(0, 12) == "--gc-growth="){
+      gcGrowth = flagValue<double>(argument);
+    }else if(argument == "--no-fold"){
+      foldConstants = false;
+    }else if(argument == "--no-dce"){
+      eliminateDeadCode = false;
+    }else if(argument == "--dce-stats"){
+      dceStats = true;
+    }else if(argument.substr(0, 17) == "--max-call-depth="){
+      interpreter.maxCallDepth = flagValue<size_t>(argument);
+    }else if(argument == "--gc-stats"){
+      gcStats = true;
+    }else{
+      arguments.push_back(argument);
+    }
+  }
+
+  Collector::instance().configure(gcThreshold, gcGrowth < 1.0 ? 1.0 : gcGrowth);
+  StandardLibrary::define(interpreter);
+  if(gcStats){
+    std::atexit([]{ Collector::instance().report(std::cerr); });
+  }
+
+  if(arguments.size() == 0){
+    return runOnOwnStack([]{ runPrompt(); return 0; });
+  }else if(arguments.size() == 1){
+    SourceBuffer source = readFile(arguments[0]); // Exits right away if it can't, before there's a session.
+    return runOnOwnStack([&source]{ return runFile(std::move(source)); });
   }else{
     std::cout << "Error! Wrong number of arguments. Should be 0 or 1." << std::endl;
+    std::cout << "Usage: myprogram [--vm] [--no-fold] [--no-dce] [--dce-stats] [--gc-threshold=N] [--gc-growth=F] [--gc-stats] [--max-call-depth=N] [script]" << std::endl;
     std::exit(64);
   }
   return 0;
@@ -1,15 +1,19 @@
 #pragma once
 
-#include <any>
 #include <string>
 #include <vector>
 
+#include "Value.hpp"
+#include "Object.hpp"
+
 class Interpreter;
 
-class LoxCallable{
+class LoxCallable : public Object{
   public:
+    LoxCallable(Object::Type type)
+      : Object{type}
+    {}
+
     virtual int arity() = 0;
-    virtual std::any call(Interpreter& interpreter, std::vector<std::any> arguments) = 0;
-    virtual std::string toString() = 0;
-    virtual ~LoxCallable() = default;
+    virtual Value call(Interpreter& interpreter, std::vector<Value> arguments) = 0;
 };
\ No newline at end of file
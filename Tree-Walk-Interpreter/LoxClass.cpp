@@ -2,12 +2,23 @@
 
 #include "LoxClass.hpp"
 
-LoxClass::LoxClass(std::string name, std::shared_ptr<LoxClass> superclass, std::map<std::string, std::shared_ptr<LoxFunction>> methods)
-  : name{std::move(name)}, superclass{superclass}, methods{std::move(methods)}
-{}
+LoxClass::LoxClass(std::string name, Ref<LoxClass> superclass, MethodTable methods)
+  : LoxCallable{Object::Type::CLASS}, name{std::move(name)}, superclass{std::move(superclass)}, methods{std::move(methods)}
+{
+  // Copy the superclass' methods down (its table is already flattened), so finding a method never has to walk up the hierarchy.
+  // emplace doesn't overwrite, so the methods this class overrides win.
+  if(this->superclass != nullptr){
+    for(const auto& [methodName, method] : this->superclass->methods){
+      this->methods.emplace(methodName, method);
+    }
+  }
+
+  initializer = findMethod(intern("init"));
+
+  track();
+}
 
 int LoxClass::arity(){
-  std::shared_ptr<LoxFunction> initializer = findMethod("init");
   if(initializer == nullptr){
     return 0;
   }
@@ -15,30 +26,42 @@ int LoxClass::arity(){
   return initializer->arity();
 }
 
-std::any LoxClass::call(Interpreter& interpreter, std::vector<std::any> arguments){
-  auto instance = std::make_shared<LoxInstance>(shared_from_this());
+Value LoxClass::call(Interpreter& interpreter, std::vector<Value> arguments){
+  auto instance = makeRef<LoxInstance>(Ref<LoxClass>{this});
 
-  std::shared_ptr<LoxFunction> initializer = findMethod("init");
   if(initializer != nullptr){
-    initializer->bind(instance)->call(interpreter, std::move(arguments));
+    initializer->invoke(interpreter, instance, std::move(arguments));
   }
   
   return instance;
 }
 
-std::shared_ptr<LoxFunction> LoxClass::findMethod(const std::string& name){
+Ref<LoxFunction> LoxClass::findMethod(LoxString* name){
   auto elem = methods.find(name);
   if(elem != methods.end()){
     return elem->second;
   }
 
-  if(superclass != nullptr){
-    return superclass->findMethod(name);
-  }
-
   return nullptr;
 }
 
 std::string LoxClass::toString(){
   return name;
 }
+
+
+void LoxClass::traceReferences(Collector& collector){
+  if(superclass != nullptr) collector.visit(superclass.get());
+  for(const auto& [methodName, method] : methods) collector.visit(method.get());
+  if(initializer != nullptr) collector.visit(initializer.get());
+
+  return;
+}
+
+void LoxClass::clearReferences(){
+  superclass = nullptr;
+  methods.clear();
+  initializer = nullptr;
+
+  return;
+}
\ No newline at end of file
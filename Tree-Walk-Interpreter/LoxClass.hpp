@@ -1,27 +1,36 @@
 #pragma once
 
-#include <any>
-#include <map>
-#include <memory>
 #include <string>
 #include <vector>
+#include <unordered_map>
 
+#include "Value.hpp"
+#include "Object.hpp"
+#include "LoxString.hpp"
+#include "Collector.hpp"
 #include "LoxCallable.hpp"
 
 class Interpreter;
 class LoxFunction;
 
-class LoxClass : public LoxCallable, public std::enable_shared_from_this<LoxClass>{
+class LoxClass : public LoxCallable{
+  public:
+    using MethodTable = std::unordered_map<LoxString*, Ref<LoxFunction>, SymbolHash>; // Keyed by the interned method name.
+
   private:
     friend class LoxInstance;
+    friend class VM;
     const std::string name;
-    const std::shared_ptr<LoxClass> superclass;
-    std::map<std::string, std::shared_ptr<LoxFunction>> methods;
+    Ref<LoxClass> superclass;
+    MethodTable methods; // Flattened: also holds every inherited method that isn't overridden.
+    Ref<LoxFunction> initializer; // The "init" method (possibly inherited), or null. Resolved once, when the class is created.
 
   public:
-    LoxClass(std::string name, std::shared_ptr<LoxClass> superclass, std::map<std::string, std::shared_ptr<LoxFunction>> methods);
+    LoxClass(std::string name, Ref<LoxClass> superclass, MethodTable methods);
     int arity() override;
-    std::any call(Interpreter& interpreter, std::vector<std::any> arguments) override;
-    std::shared_ptr<LoxFunction> findMethod(const std::string& name);
+    Value call(Interpreter& interpreter, std::vector<Value> arguments) override;
+    Ref<LoxFunction> findMethod(LoxString* name);
     std::string toString() override;
+    void traceReferences(Collector& collector) override;
+    void clearReferences() override;
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include <utility>
+#include <iterator>
 
 #include "Stmt.hpp"
 #include "Environment.hpp"
@@ -6,45 +7,100 @@
 #include "LoxFunction.hpp"
 #include "LoxInstance.hpp"
 
-LoxFunction::LoxFunction(std::shared_ptr<Function> declaration, std::shared_ptr<Environment> closure, bool isInitializer)
-  : declaration{std::move(declaration)}, closure{std::move(closure)}, isInitializer{isInitializer}
-{}
+LoxFunction::LoxFunction(Function* declaration, Ref<Environment> closure, bool isInitializer, Value receiver)
+  : LoxCallable{Object::Type::FUNCTION}, declaration{std::move(declaration)}, closure{std::move(closure)}, isInitializer{isInitializer}, receiver{std::move(receiver)}
+{
+  track();
+}
 
 std::string LoxFunction::toString(){
-  return "<fun " + declaration->name.lexeme + ">"; // This method is responsible for print the function value (not the function call).
+  return "<fun " + std::string{declaration->name.lexeme} + ">"; // This method is responsible for print the function value (not the function call).
 }
 
 int LoxFunction::arity(){
   return declaration->parameters.size();
 }
 
-std::shared_ptr<LoxFunction> LoxFunction::bind(std::shared_ptr<LoxInstance> instance){
-  auto environment = std::make_shared<Environment>(closure);
-  environment->define("this", instance);
-  
-  return std::make_shared<LoxFunction>(declaration, environment, isInitializer);
+// A bound method only remembers its receiver. The receiver is placed in the call's own environment (slot 0, where the Resolver put 'this'),
+// so binding doesn't create an environment of its own.
+Ref<LoxFunction> LoxFunction::bind(Ref<LoxInstance> instance){
+  return makeRef<LoxFunction>(declaration, closure, isInitializer, std::move(instance));
+}
+
+Value LoxFunction::call(Interpreter& interpreter, std::vector<Value> arguments){
+  return invoke(interpreter, receiver, std::move(arguments));
 }
 
-std::any LoxFunction::call(Interpreter& interpreter, std::vector<std::any> arguments){
-  auto environment = std::make_shared<Environment>(closure); // Create the current local environment of the LoxFunction.
+// Calls the function with an explicit receiver (nil for plain functions). Method calls like "object.name(...)" come straight here,
+// without binding the method to the object first.
+Value LoxFunction::invoke(Interpreter& interpreter, const Value& receiver, std::vector<Value> arguments){
+  Value result = run(interpreter, receiver, std::move(arguments));
 
-  for(int i = 0; i < declaration->parameters.size(); i++){ // Execute the binding of the parameters of the LoxFunction to its respective arguments.
-    environment->define(declaration->parameters[i].lexeme, arguments[i]);
+  // A "return f(...);" in the body leaves the call to 'f' to us (see Interpreter::evaluateTailCall), once the frame of the
+  // call that returns it is gone. So a chain of tail calls runs in this loop, in constant native stack, however long it is.
+  while(interpreter.tailCalling){
+    Interpreter::TailCall call = interpreter.takeTailCall();
+    result = call.function->run(interpreter, call.receiver, std::move(call.arguments));
   }
 
-  try{
-    interpreter.executeBlock(declaration->body, environment); // Execute the body of the funtion by passing its statements and its current environment.
-  }catch(LoxReturn returnValue){
-    if(isInitializer){
-      return closure->getAt(0, "this");
+  return result;
+}
+
+// Runs the body once. The result is nil if the body ended with a tail call that's still pending.
+Value LoxFunction::run(Interpreter& interpreter, const Value& receiver, std::vector<Value> arguments){
+  Collector::instance().collectIfNeeded(); // Calls are safe points.
+
+  if(declaration->onStack){
+    // Nothing in the body can capture its variables, so they go in a frame of the value stack and the body runs
+    // directly in the closure, without an environment of its own.
+    Interpreter::StackFrame frame{interpreter, declaration->frameSize};
+    size_t slot = interpreter.frameBase;
+    if(!receiver.isNil()){
+      interpreter.stack[slot++] = receiver;
+    }
+    for(Value& argument : arguments){
+      interpreter.stack[slot++] = std::move(argument);
+    }
+
+    interpreter.executeBlock(declaration->body, closure);
+  }else{
+    auto environment = makeRef<Environment>(closure); // Create the current local environment of the LoxFunction.
+
+    // Execute the binding of the parameters of the LoxFunction to its respective arguments (parameter i lives in slot i, or i + 1 for methods).
+    // The slots usually come from a recycled environment and already have room for them, so they're copied in instead of taking over 'arguments'.
+    environment->slots.reserve(arguments.size() + 1);
+    if(!receiver.isNil()){
+      environment->slots.push_back(receiver);
     }
+    environment->slots.insert(environment->slots.end(), std::make_move_iterator(arguments.begin()), std::make_move_iterator(arguments.end()));
 
-    return returnValue.value;
+    interpreter.executeBlock(declaration->body, environment); // Execute the body of the funtion by passing its statements and its current environment.
+  }
+
+  if(interpreter.returning){
+    Value value = interpreter.finishReturn();
+    if(!isInitializer){
+      return value;
+    }
   }
 
   if(isInitializer){
-    return closure->getAt(0, "this");
+    return receiver;
   }
 
   return nullptr; // Automatically deals with the case where there is no 'return' statement in the body of the function. By default, in these cases, Lox functions return nil.
+}
+
+void LoxFunction::traceReferences(Collector& collector){
+  collector.visit(closure.get());
+  collector.visit(receiver);
+
+  return;
+}
+
+void LoxFunction::clearReferences(){
+  closure = nullptr;
+  receiver = nullptr;
+
+  return;
 }
\ No newline at end of file
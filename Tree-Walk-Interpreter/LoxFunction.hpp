@@ -1,26 +1,36 @@
 #pragma once
 
-#include <any>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "Value.hpp"
+#include "Object.hpp"
+#include "Environment.hpp"
 #include "LoxCallable.hpp"
 
-class Environment;
 class Function;
 class LoxInstance;
 
 class LoxFunction : public LoxCallable{
   private:
+    friend class VM;
+    friend class Interpreter;
+
     bool isInitializer;
-    std::shared_ptr<Function> declaration;
-    std::shared_ptr<Environment> closure;
+    Function* declaration;
+    Ref<Environment> closure;
+    Value receiver; // The instance a method was bound to ('this'), or nil.
+
+    Value run(Interpreter& interpreter, const Value& receiver, std::vector<Value> arguments);
 
   public:
-    LoxFunction(std::shared_ptr<Function> declaration, std::shared_ptr<Environment> closure, bool isInitializer);
+    LoxFunction(Function* declaration, Ref<Environment> closure, bool isInitializer, Value receiver = nullptr);
     int arity() override;
-    std::shared_ptr<LoxFunction> bind(std::shared_ptr<LoxInstance> instance);
-    std::any call(Interpreter& interpreter, std::vector<std::any> arguments) override;
+    Ref<LoxFunction> bind(Ref<LoxInstance> instance);
+    Value call(Interpreter& interpreter, std::vector<Value> arguments) override;
+    Value invoke(Interpreter& interpreter, const Value& receiver, std::vector<Value> arguments);
     std::string toString() override;
+    void traceReferences(Collector& collector) override;
+    void clearReferences() override;
 };
\ No newline at end of file
@@ -3,30 +3,86 @@
 #include "Error.hpp"
 #include "LoxInstance.hpp"
 
-LoxInstance::LoxInstance(std::shared_ptr<LoxClass> klass)
-  : klass{std::move(klass)}
-{}
-
-std::any LoxInstance::get(const Token& name){
-  auto elem = fields.find(name.lexeme);
-  if(elem != fields.end()){
-    return elem->second;
+LoxInstance::LoxInstance(Ref<LoxClass> klass)
+  : Object{Object::Type::INSTANCE}, klass{std::move(klass)}, shape{Shape::root()}
+{
+  track();
+}
+
+Value LoxInstance::get(const Token& name, PropertyCache& cache){
+  Value* field = findField(name, cache);
+  if(field != nullptr){
+    return *field;
   }
 
-  std::shared_ptr<LoxFunction> method = klass->findMethod(name.lexeme);
+  LoxFunction* method = findMethod(name.symbol);
   if(method != nullptr){
-    return method->bind(shared_from_this());
+    return method->bind(Ref<LoxInstance>{this});
   }
 
-  throw RuntimeError(name, "Undefined property '" + name.lexeme + "'.");
+  throw RuntimeError(name, "Undefined property '" + std::string{name.lexeme} + "'.");
 }
 
-void LoxInstance::set(const Token& name, std::any value){
-  fields[name.lexeme] = std::move(value);
+// Returns the field with the given name, or null if this instance doesn't have it.
+Value* LoxInstance::findField(const Token& name, PropertyCache& cache){
+  const PropertyCache::Entry* entry = cache.find(shape);
+  if(entry != nullptr){
+    return &fields[entry->slot];
+  }
+
+  int slot = shape->lookup(name.symbol);
+  if(slot != -1){
+    cache.add(PropertyCache::Entry{shape, nullptr, slot});
+    return &fields[slot];
+  }
+
+  return nullptr;
+}
+
+// Returns the (unbound) method with the given name, or null. It's kept alive by the class.
+LoxFunction* LoxInstance::findMethod(LoxString* name){
+  return klass->findMethod(name).get();
+}
+
+void LoxInstance::set(const Token& name, Value value, PropertyCache& cache){
+  PropertyCache::Entry entry;
+  if(const PropertyCache::Entry* cached = cache.find(shape)){
+    entry = *cached;
+  }else{
+    int slot = shape->lookup(name.symbol);
+    if(slot != -1){
+      entry = PropertyCache::Entry{shape, nullptr, slot};
+    }else{
+      entry = PropertyCache::Entry{shape, shape->addField(name.symbol), static_cast<int>(fields.size())};
+    }
+    cache.add(entry);
+  }
+
+  if(entry.transition != nullptr){ // It's a new field, so it goes right after the existing ones.
+    shape = entry.transition;
+    fields.push_back(std::move(value));
+  }else{
+    fields[entry.slot] = std::move(value);
+  }
 
   return;
 }
 
 std::string LoxInstance::toString(){
   return klass->name + " instance";
+}
+
+void LoxInstance::traceReferences(Collector& collector){
+  if(klass != nullptr) collector.visit(klass.get());
+  for(const Value& field : fields) collector.visit(field);
+
+  return;
+}
+
+void LoxInstance::clearReferences(){
+  klass = nullptr;
+  shape = Shape::root();
+  fields.clear();
+
+  return;
 }
\ No newline at end of file
@@ -1,24 +1,33 @@
 #pragma once
 
-#include <any>
-#include <map>
-#include <memory>
 #include <string>
+#include <vector>
 
+#include "Shape.hpp"
+#include "Value.hpp"
+#include "Object.hpp"
 #include "LoxClass.hpp"
+#include "Collector.hpp"
 #include "LoxFunction.hpp"
+#include "PropertyCache.hpp"
 
 class LoxFunction;
 class Token;
 
-class LoxInstance: public std::enable_shared_from_this<LoxInstance> {
+class LoxInstance : public Object{
   private:
-    std::shared_ptr<LoxClass> klass;
-    std::map<std::string, std::any> fields;
+    friend class VM;
+    Ref<LoxClass> klass;
+    Shape* shape; // Tells which field lives in which slot.
+    std::vector<Value> fields;
 
   public:
-    LoxInstance(std::shared_ptr<LoxClass> klass);
-    std::any get(const Token& name);
-    void set(const Token& name, std::any value);
-    std::string toString();
+    LoxInstance(Ref<LoxClass> klass);
+    Value get(const Token& name, PropertyCache& cache);
+    Value* findField(const Token& name, PropertyCache& cache);
+    LoxFunction* findMethod(LoxString* name);
+    void set(const Token& name, Value value, PropertyCache& cache);
+    std::string toString() override;
+    void traceReferences(Collector& collector) override;
+    void clearReferences() override;
 };
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Value.hpp"
+#include "Object.hpp"
+#include "LoxCallable.hpp"
+
+class Interpreter;
+
+// A function implemented in C++ (see StandardLibrary.hpp). Both engines call it directly, with the arguments already evaluated.
+// It reports errors by throwing a NativeError, which the call turns into a RuntimeError at the call site.
+class LoxNative : public LoxCallable{
+  public:
+    using Implementation = Value (*)(Interpreter& interpreter, std::vector<Value>& arguments);
+
+  private:
+    const int parameters;
+    const Implementation implementation;
+
+  public:
+    LoxNative(int arity, Implementation implementation)
+      : LoxCallable{Object::Type::NATIVE}, parameters{arity}, implementation{implementation}
+    {}
+
+    int arity() override{
+      return parameters;
+    }
+
+    Value call(Interpreter& interpreter, std::vector<Value> arguments) override{
+      return implementation(interpreter, arguments);
+    }
+
+    std::string toString() override{
+      return "<native fun>";
+    }
+};
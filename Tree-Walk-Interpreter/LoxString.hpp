@@ -0,0 +1,140 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <utility>
+#include <string_view>
+#include <vector>
+
+#include "Object.hpp"
+#include "Value.hpp"
+
+class LoxString : public Object{
+  private:
+    // The characters live in a buffer that can be shared by several strings: 's + piece' appends 'piece' to the buffer of 's'
+    // (when nothing was appended to it before) and the result is a new string over the longer buffer. Each string only
+    // ever looks at its first 'length' characters, which never change, so 's' itself is unaffected. This makes the usual
+    // 's = s + piece;' loop linear, since the buffer grows geometrically instead of being copied on every iteration.
+    std::shared_ptr<std::string> buffer;
+    size_t length;
+
+    LoxString(std::shared_ptr<std::string> buffer, size_t length)
+      : Object{Object::Type::STRING}, buffer{std::move(buffer)}, length{length}
+    {}
+
+  public:
+    size_t hash = 0; // Only computed for interned strings (symbols).
+    bool interned = false; // Symbols are shared by the whole program, so nothing is ever appended to their buffer.
+
+    LoxString(std::string chars)
+      : Object{Object::Type::STRING}, buffer{std::make_shared<std::string>(std::move(chars))}, length{buffer->length()}
+    {}
+
+    // The view is only valid until the next concatenation, which may move the buffer.
+    std::string_view chars() const{
+      return std::string_view{buffer->data(), length};
+    }
+
+    std::string toString() override{
+      return std::string{chars()};
+    }
+
+    // Returns left + right.
+    static Ref<LoxString> concatenate(LoxString* left, LoxString* right){
+      std::shared_ptr<std::string> buffer = left->buffer;
+
+      if(left->interned || buffer->length() != left->length){
+        // Someone else already extended the buffer past 'left' (or it belongs to a symbol): copy on write.
+        buffer = std::make_shared<std::string>();
+        buffer->reserve(left->length + right->length);
+        buffer->append(left->chars());
+        buffer->append(right->chars());
+      }else if(right->buffer == buffer){
+        // 's + s': the characters being appended live in the buffer that's about to grow.
+        std::string suffix{right->chars()};
+        buffer->append(suffix);
+      }else{
+        buffer->append(right->chars());
+      }
+
+      return Ref<LoxString>{new LoxString{std::move(buffer), left->length + right->length}};
+    }
+};
+
+// Helper to wrap a C++ string as a Lox string value.
+inline Value makeString(std::string chars){
+  return Value{makeRef<LoxString>(std::move(chars))};
+}
+
+// Symbol table shared by the whole program. The Scanner interns every identifier and string literal, so each distinct name
+// exists exactly once and two names are the same if and only if they are the same LoxString*. Lookups by name (globals, fields,
+// methods) then hash and compare pointers instead of characters. Interned strings live until the program ends.
+class StringTable{
+  private:
+    // Open addressing with linear probing: a symbol costs one pointer here, instead of a node per entry.
+    // The capacity is always a power of two and the table is never more than half full.
+    std::vector<LoxString*> entries = std::vector<LoxString*>(1024, nullptr);
+    size_t count = 0;
+
+    void grow(){
+      std::vector<LoxString*> old = std::move(entries);
+      entries.assign(old.size() * 2, nullptr);
+
+      for(LoxString* string : old){
+        if(string == nullptr) continue;
+
+        size_t index = string->hash & (entries.size() - 1);
+        while(entries[index] != nullptr){
+          index = (index + 1) & (entries.size() - 1);
+        }
+        entries[index] = string;
+      }
+
+      return;
+    }
+
+    StringTable() = default;
+
+  public:
+    static StringTable& instance(){
+      static StringTable table;
+
+      return table;
+    }
+
+    LoxString* intern(std::string_view chars){
+      size_t hash = std::hash<std::string_view>{}(chars);
+
+      size_t index = hash & (entries.size() - 1);
+      while(entries[index] != nullptr){
+        if(entries[index]->hash == hash && entries[index]->chars() == chars){
+          return entries[index];
+        }
+        index = (index + 1) & (entries.size() - 1);
+      }
+
+      LoxString* string = new LoxString{std::string{chars}};
+      string->retain(); // Owned by the table.
+      string->hash = hash;
+      string->interned = true;
+      entries[index] = string;
+
+      if(++count * 2 > entries.size()){
+        grow();
+      }
+
+      return string;
+    }
+};
+
+inline LoxString* intern(std::string_view chars){
+  return StringTable::instance().intern(chars);
+}
+
+// Hash for containers keyed by interned strings: the hash was computed once, when the string was interned.
+struct SymbolHash{
+  size_t operator()(const LoxString* symbol) const{
+    return symbol->hash;
+  }
+};
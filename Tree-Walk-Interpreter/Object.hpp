@@ -0,0 +1,177 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+
+class Collector;
+
+// Base class of every heap-allocated runtime value (strings, functions, classes, instances...).
+// Objects are reference counted intrusively so that a Value only needs to carry a raw pointer.
+class Object{
+  public:
+    enum class Type{
+      STRING,
+      FUNCTION,
+      NATIVE,
+      CLASS,
+      INSTANCE,
+      ENVIRONMENT
+    };
+
+  private:
+    friend class Collector;
+
+    // Every object that can hold references to other objects (environments, functions, classes and instances).
+    // Only those can be part of a reference cycle, which is what the Collector looks for.
+    static inline std::vector<Object*> trackedObjects;
+    int trackedIndex = -1; // Position in trackedObjects, or -1 if the object isn't tracked.
+    int gcRefs = 0; // Scratch counter for the Collector.
+
+  protected:
+    // Called by the constructor of every kind of object that can reference other objects.
+    void track(){
+      trackedIndex = trackedObjects.size();
+      trackedObjects.push_back(this);
+
+      return;
+    }
+
+  public:
+    const Type type;
+    int refCount = 0;
+
+    Object(Type type)
+      : type{type}
+    {}
+
+    Object(const Object&) = delete;
+    Object& operator=(const Object&) = delete;
+
+    virtual ~Object(){
+      if(trackedIndex >= 0){
+        Object* last = trackedObjects.back();
+        trackedObjects[trackedIndex] = last;
+        last->trackedIndex = trackedIndex;
+        trackedObjects.pop_back();
+      }
+    }
+
+    virtual std::string toString() = 0;
+
+    // Hands every object this one holds a reference to to 'collector.visit'. Only needed for tracked objects.
+    virtual void traceReferences(Collector& collector){
+      return;
+    }
+
+    // Drops every reference this object holds. The Collector uses it to break the cycles it found to be garbage.
+    virtual void clearReferences(){
+      return;
+    }
+
+    void retain(){
+      refCount++;
+
+      return;
+    }
+
+    void release(){
+      if(--refCount == 0){
+        delete this;
+      }
+
+      return;
+    }
+};
+
+// Owning pointer to an Object. Works like std::shared_ptr, but the counter lives inside the object itself.
+template<class T>
+class Ref{
+  private:
+    template<class U> friend class Ref;
+
+    T* ptr = nullptr;
+
+  public:
+    Ref() = default;
+
+    Ref(std::nullptr_t)
+    {}
+
+    Ref(T* ptr)
+      : ptr{ptr}
+    {
+      if(ptr != nullptr) ptr->retain();
+    }
+
+    Ref(const Ref& other)
+      : Ref{other.ptr}
+    {}
+
+    Ref(Ref&& other) noexcept
+      : ptr{other.ptr}
+    {
+      other.ptr = nullptr;
+    }
+
+    template<class U, class = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    Ref(const Ref<U>& other)
+      : Ref{static_cast<T*>(other.ptr)}
+    {}
+
+    template<class U, class = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    Ref(Ref<U>&& other) noexcept
+      : ptr{other.ptr}
+    {
+      other.ptr = nullptr;
+    }
+
+    ~Ref(){
+      if(ptr != nullptr) ptr->release();
+    }
+
+    Ref& operator=(Ref other) noexcept{
+      std::swap(ptr, other.ptr);
+
+      return *this;
+    }
+
+    T* get() const{
+      return ptr;
+    }
+
+    T* operator->() const{
+      return ptr;
+    }
+
+    T& operator*() const{
+      return *ptr;
+    }
+
+    explicit operator bool() const{
+      return ptr != nullptr;
+    }
+
+    bool operator==(const Ref& other) const{
+      return ptr == other.ptr;
+    }
+
+    bool operator!=(const Ref& other) const{
+      return ptr != other.ptr;
+    }
+
+    bool operator==(std::nullptr_t) const{
+      return ptr == nullptr;
+    }
+
+    bool operator!=(std::nullptr_t) const{
+      return ptr != nullptr;
+    }
+};
+
+template<class T, class... Args>
+Ref<T> makeRef(Args&&... args){
+  return Ref<T>{new T(std::forward<Args>(args)...)};
+}
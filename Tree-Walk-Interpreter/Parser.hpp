@@ -9,9 +9,12 @@
 #include <vector>
 
 #include "Expr.hpp"
+#include "Arena.hpp"
 #include "Stmt.hpp"
 #include "Error.hpp"
 #include "Token.hpp"
+#include "Scanner.hpp"
+#include "LoxString.hpp"
 #include "TokenType.hpp"
 
 class Parser{
@@ -20,11 +23,13 @@ class Parser{
     struct ParseError: public std::runtime_error {
       using std::runtime_error::runtime_error;
     };
-    const std::vector<Token>& tokens;
-    int current = 0; // Points to the index of the next token waiting to be consumed.
+    Scanner& scanner; // Tokens are pulled from the scanner one at a time. The parser never needs more than the two below.
+    Arena& arena; // Every node the parser creates is allocated here.
+    Token current; // The next token waiting to be consumed.
+    Token last; // The most recently consumed token.
 
     // Function equivalent to the "declaration" rule.
-    std::shared_ptr<Stmt> declaration(){
+    Stmt* declaration(){
       try{
         if(match(TokenType::CLASS)){
           return classDeclaration();
@@ -43,42 +48,42 @@ class Parser{
     }
 
     // Function equivalent to the "classDecl" rule.
-    std::shared_ptr<Stmt> classDeclaration(){
+    Stmt* classDeclaration(){
       Token name = consume(TokenType::IDENTIFIER, "Expect class name.");
 
-      std::shared_ptr<Variable> superclass = nullptr;
+      Variable* superclass = nullptr;
       if(match(TokenType::LESS)){
         consume(TokenType::IDENTIFIER, "Expect superclass name.");
-        superclass = std::make_shared<Variable>(previous());
+        superclass = arena.make<Variable>(previous());
       }
 
       consume(TokenType::LEFT_BRACE, "Expect '{' before class body.");
 
-      std::vector<std::shared_ptr<Function>> methods;
+      std::vector<Function*> methods;
       while(!check(TokenType::RIGHT_BRACE) && !isAtEnd()){
         methods.push_back(function("method"));
       }
 
       consume(TokenType::RIGHT_BRACE, "Expect '}' after class body.");
 
-      return std::make_shared<Class>(std::move(name), superclass, std::move(methods));
+      return arena.make<Class>(std::move(name), superclass, std::move(methods));
     }
 
     // Function equivalent to the "varDecl" rule.
-    std::shared_ptr<Stmt> varDeclaration(){
+    Stmt* varDeclaration(){
       Token name = consume(TokenType::IDENTIFIER, "Expected variable name after keyword 'var'.");
-      std::shared_ptr<Expr> initializer = nullptr;
+      Expr* initializer = nullptr;
 
       if(match(TokenType::EQUAL)){
         initializer = expression();
       }
 
       consume(TokenType::SEMICOLON, "Expected ';' after variable declaration.");
-      return std::make_shared<Var>(std::move(name), initializer);
+      return arena.make<Var>(std::move(name), initializer);
     }
 
     // Function equivalent to the "statement" rule.
-    std::shared_ptr<Stmt> statement(){
+    Stmt* statement(){
       if(match(TokenType::FOR)){
         return forStatement();
       }
@@ -89,7 +94,7 @@ class Parser{
         return printStatement();
       }
       if(match(TokenType::LEFT_BRACE)){
-        return std::make_shared<Block>(block());
+        return arena.make<Block>(block());
       }
       if(match(TokenType::RETURN)){
         return returnStatement();
@@ -102,11 +107,11 @@ class Parser{
     }
 
     // Function equivalent to the "forStatement" rule.
-    std::shared_ptr<Stmt> forStatement(){
+    Stmt* forStatement(){
       consume(TokenType::LEFT_PAREN, "Expect a '(' after 'for'.");
 
       // Checking for the "initializer" clause of the "for" loop.
-      std::shared_ptr<Stmt> initializer;
+      Stmt* initializer;
       if(match(TokenType::SEMICOLON)){
         initializer = nullptr;
       }else if(match(TokenType::VAR)){
@@ -116,39 +121,39 @@ class Parser{
       }
 
       // Checking for the "condition" clause of the "for" loop.
-      std::shared_ptr<Expr> condition = nullptr;
+      Expr* condition = nullptr;
       if(!check(TokenType::SEMICOLON)){
         condition = expression();
       }
       consume(TokenType::SEMICOLON, "Expected a ';' after the 'for' condition.");
 
       // Checking for the "increment" clause of the "for" loop.
-      std::shared_ptr<Expr> increment = nullptr;
+      Expr* increment = nullptr;
       if(!check(TokenType::RIGHT_PAREN)){
         increment = expression();
       }
       consume(TokenType::RIGHT_PAREN, "Expect ')' after 'for' clauses.");
 
       // Checking for the body of the 'for' loop.
-      std::shared_ptr<Stmt> body = statement();
+      Stmt* body = statement();
 
       if(increment != nullptr){
-        body = std::make_shared<Block>(
-          std::vector<std::shared_ptr<Stmt>>{
+        body = arena.make<Block>(
+          std::vector<Stmt*>{
             body,
-            std::make_shared<Expression>(increment)
+            arena.make<Expression>(increment)
           }
         );
       }
 
       if(condition == nullptr){
-        condition = std::make_shared<Literal>(true);
+        condition = arena.make<Literal>(true);
       }
-      body = std::make_shared<While>(condition, body);
+      body = arena.make<While>(condition, body);
 
       if(initializer != nullptr){
-        body = std::make_shared<Block>(
-          std::vector<std::shared_ptr<Stmt>>{
+        body = arena.make<Block>(
+          std::vector<Stmt*>{
             initializer,
             body
           }
@@ -159,33 +164,33 @@ class Parser{
     }
 
     // Function equivalent to the "ifStatement" rule.
-    std::shared_ptr<Stmt> ifStatement(){
+    Stmt* ifStatement(){
       consume(TokenType::LEFT_PAREN, "Expected a '(' after 'if'.");
-      std::shared_ptr<Expr> condition = expression();
+      Expr* condition = expression();
       consume(TokenType::RIGHT_PAREN, "Expected a ')' after the condition of an 'if'.");
 
-      std::shared_ptr<Stmt> ifBranch = statement();
-      std::shared_ptr<Stmt> elseBranch = nullptr;
+      Stmt* ifBranch = statement();
+      Stmt* elseBranch = nullptr;
 
       if(match(TokenType::ELSE)){
         elseBranch = statement();
       }
 
-      return std::make_shared<If>(condition, ifBranch, elseBranch);
+      return arena.make<If>(condition, ifBranch, elseBranch);
     }
 
     // Function equivalent to the "printStatement" rule.
-    std::shared_ptr<Stmt> printStatement(){
-      std::shared_ptr<Expr> value = expression();
+    Stmt* printStatement(){
+      Expr* value = expression();
       consume(TokenType::SEMICOLON, "Expected a ';' at the end of a PRINT statement.");
 
-      return std::make_shared<Print>(value);
+      return arena.make<Print>(value);
     }
 
     // Function equivalent to the "returnStatement" rule.
-    std::shared_ptr<Stmt> returnStatement(){
+    Stmt* returnStatement(){
       Token keyword = previous();
-      std::shared_ptr<Expr> value = nullptr;
+      Expr* value = nullptr;
 
       if(!check(TokenType::SEMICOLON)){ // If the there is no ';' token after the 'return' token, then we expect an expression.
         value = expression();
@@ -193,19 +198,22 @@ class Parser{
 
       consume(TokenType::SEMICOLON, "Expect a ';' after a return value"); // In both cases (where we have and where we don't have a return value) we expect a ';' at the end of the return statement.
 
-      return std::make_shared<Return>(keyword, value);
+      Return* stmt = arena.make<Return>(keyword, value);
+      stmt->tailCall = Return::isTailCall(value);
+
+      return stmt;
     }
 
     // Function equivalent to the "expressionStatement" rule.
-    std::shared_ptr<Stmt> expressionStatement(){
-      std::shared_ptr<Expr> expr = expression();
+    Stmt* expressionStatement(){
+      Expr* expr = expression();
       consume(TokenType::SEMICOLON, "Expected a ';' at the end of an expression statement");
 
-      return std::make_shared<Expression>(expr);
+      return arena.make<Expression>(expr);
     }
 
     // Function equivalent to the "function" rule.
-    std::shared_ptr<Function> function(std::string kind){
+    Function* function(std::string kind){
       Token name = consume(TokenType::IDENTIFIER, "Expect a " + kind + " name."); // Stores the token with the name of the function.
 
       consume(TokenType::LEFT_PAREN, "Expect '(' after a " + kind + " name."); // Consume the left parenthesis after a function name in a function declaration.
@@ -223,14 +231,14 @@ class Parser{
       consume(TokenType::RIGHT_PAREN, "Expect a ')' after parameters."); // Finally, whether the function has 0 or more parameters, we should expect a ')' character.
     
       consume(TokenType::LEFT_BRACE, "Expect a '{' before a " + kind + " body.");
-      std::vector<std::shared_ptr<Stmt>> body = block();
+      std::vector<Stmt*> body = block();
 
-      return std::make_shared<Function>(std::move(name), std::move(parameters), std::move(body));
+      return arena.make<Function>(std::move(name), std::move(parameters), std::move(body));
     }
 
     // Function equivalent to the "block" rule.
-    std::vector<std::shared_ptr<Stmt>> block(){
-      std::vector<std::shared_ptr<Stmt>> statements;
+    std::vector<Stmt*> block(){
+      std::vector<Stmt*> statements;
 
       while(!check(TokenType::RIGHT_BRACE) && !isAtEnd()){
         statements.push_back(declaration());
@@ -242,34 +250,34 @@ class Parser{
     }
 
     // Function equivalent to the "while" rule.
-    std::shared_ptr<Stmt> whileStatement(){
+    Stmt* whileStatement(){
       consume(TokenType::LEFT_PAREN, "Expect '(' after 'while'.");
-      std::shared_ptr<Expr> condition = expression();
+      Expr* condition = expression();
       consume(TokenType::RIGHT_PAREN, "Expect ')' after 'while' condition.");
-      std::shared_ptr<Stmt> body = statement();
+      Stmt* body = statement();
 
-      return std::make_shared<While>(condition, body);
+      return arena.make<While>(condition, body);
     }
 
     // Function equivalent to the "expression" rule.
-    std::shared_ptr<Expr> expression(){
+    Expr* expression(){
       return assignment();
     }
 
     // Function equivalent to the "assignment" rule.
     // Remember that an assignment is also an expression whose resulting value is the R-value of it.
-    std::shared_ptr<Expr> assignment(){
-      std::shared_ptr<Expr> expr = orExpression(); // This can either evaluate to a L-value or a R-value.
+    Expr* assignment(){
+      Expr* expr = orExpression(); // This can either evaluate to a L-value or a R-value.
 
       if(match(TokenType::EQUAL)){
         Token equals = previous(); // This contains the token of TokenType::EQUAL
-        std::shared_ptr<Expr> value = assignment();
+        Expr* value = assignment();
 
-        if(Variable* e = dynamic_cast<Variable*>(expr.get())){
+        if(Variable* e = dynamic_cast<Variable*>(expr)){
           Token name = e->name;
-          return std::make_shared<Assign>(std::move(name), value);
-        }else if(Get* get = dynamic_cast<Get*>(expr.get())){
-          return std::make_shared<Set>(get->object, get->name, value);
+          return arena.make<Assign>(std::move(name), value);
+        }else if(Get* get = dynamic_cast<Get*>(expr)){
+          return arena.make<Set>(get->object, get->name, value);
         }
 
         error(std::move(equals), "Invalid assignment target.");
@@ -279,26 +287,26 @@ class Parser{
     }
 
     // Function equivalent to the "or" rule.
-    std::shared_ptr<Expr> orExpression(){
-      std::shared_ptr<Expr> expr = andExpression();
+    Expr* orExpression(){
+      Expr* expr = andExpression();
 
       while(match(TokenType::OR)){
         Token op = previous();
-        std::shared_ptr<Expr> right = andExpression();
-        expr = std::make_shared<Logical>(expr, std::move(op), right);
+        Expr* right = andExpression();
+        expr = arena.make<Logical>(expr, std::move(op), right);
       }
 
       return expr;
     }
 
     // Function equivalent to the "and" rule.
-    std::shared_ptr<Expr> andExpression(){
-      std::shared_ptr<Expr> expr = equality();
+    Expr* andExpression(){
+      Expr* expr = equality();
 
       while(match(TokenType::AND)){
         Token op = previous();
-        std::shared_ptr<Expr> right = equality();
-        expr = std::make_shared<Logical>(expr, std::move(op), right);
+        Expr* right = equality();
+        expr = arena.make<Logical>(expr, std::move(op), right);
       }
 
       return expr;
@@ -310,13 +318,13 @@ class Parser{
     // Note that if the parser never encounters an equality operator, then it never enters the loop.
     // In that case, the equality() method effectively calls and returns comparison().
     // In that way, this method matches an equality operator or anything of higher precedence.
-    std::shared_ptr<Expr> equality(){
-      std::shared_ptr<Expr> expr = comparison();
+    Expr* equality(){
+      Expr* expr = comparison();
 
       while(match(TokenType::BANG_EQUAL, TokenType::EQUAL_EQUAL)){
         Token op = previous();
-        std::shared_ptr<Expr> right = comparison();
-        expr = std::make_shared<Binary>(expr, std::move(op), right);
+        Expr* right = comparison();
+        expr = arena.make<Binary>(expr, std::move(op), right);
       }
 
       return expr;
@@ -328,13 +336,13 @@ class Parser{
     // Note that if the parser never encounters a comparison operator, then it never enters the loop.
     // In that case, the comparison() method effectively calls and returns term().
     // In that way, this method matches a comparison operator or anything of higher precedence.
-    std::shared_ptr<Expr> comparison(){
-      std::shared_ptr<Expr> expr = term();
+    Expr* comparison(){
+      Expr* expr = term();
 
       while(match(TokenType::LESS, TokenType::LESS_EQUAL, TokenType::GREATER, TokenType::GREATER_EQUAL)){
         Token op = previous();
-        std::shared_ptr<Expr> right = term();
-        expr = std::make_shared<Binary>(expr, std::move(op), right);
+        Expr* right = term();
+        expr = arena.make<Binary>(expr, std::move(op), right);
       }
 
       return expr;
@@ -346,13 +354,13 @@ class Parser{
     // Note that if the parser never encounters a term operator, then it never enters the loop.
     // In that case, the term() method effectively calls and returns factor().
     // In that way, this method matches a term operator or anything of higher precedence.
-    std::shared_ptr<Expr> term(){
-      std::shared_ptr<Expr> expr = factor();
+    Expr* term(){
+      Expr* expr = factor();
 
       while(match(TokenType::MINUS, TokenType::PLUS)){
         Token op = previous();
-        std::shared_ptr<Expr> right = factor();
-        expr = std::make_shared<Binary>(expr, std::move(op), right);
+        Expr* right = factor();
+        expr = arena.make<Binary>(expr, std::move(op), right);
       }
 
       return expr;
@@ -364,13 +372,13 @@ class Parser{
     // Note that if the parser never encounters a factor operator, then it never enters the loop.
     // In that case, the factor() method effectively calls and returns unary().
     // In that way, this method matches a factor operator or anything of higher precedence.
-    std::shared_ptr<Expr> factor(){
-      std::shared_ptr<Expr> expr = unary();
+    Expr* factor(){
+      Expr* expr = unary();
 
       while(match(TokenType::SLASH, TokenType::STAR)){
         Token op = previous();
-        std::shared_ptr<Expr> right = unary();
-        expr = std::make_shared<Binary>(expr, std::move(op), right);
+        Expr* right = unary();
+        expr = arena.make<Binary>(expr, std::move(op), right);
       }
 
       return expr;
@@ -382,19 +390,19 @@ class Parser{
     // Note that if the parser never encounters an unary operator, then it never enters the if-clause.
     // In that case, the unary() method will enter the else-clause and effectively calls and returns call().
     // In that way, this method matches an unary operator or anything of higher precedence.
-    std::shared_ptr<Expr> unary(){
+    Expr* unary(){
       if(match(TokenType::MINUS, TokenType::BANG)){
         Token op = previous();
-        std::shared_ptr<Expr> right = unary();
-        return std::make_shared<Unary>(std::move(op), right);
+        Expr* right = unary();
+        return arena.make<Unary>(std::move(op), right);
       }
 
       return call();
     }
 
     // Auxiliar function to the one that implements the "call" rule.
-    std::shared_ptr<Expr> finishCall(std::shared_ptr<Expr> callee){
-      std::vector<std::shared_ptr<Expr>> arguments;
+    Expr* finishCall(Expr* callee){
+      std::vector<Expr*> arguments;
 
       if(!check(TokenType::RIGHT_PAREN)){
         do{
@@ -407,20 +415,23 @@ class Parser{
 
       Token paren = consume(TokenType::RIGHT_PAREN, "Expect ')' after arguments of a function/method.");
 
-      return std::make_shared<Call>(callee, std::move(paren), std::move(arguments));
+      Call* call = arena.make<Call>(callee, std::move(paren), std::move(arguments));
+      call->method = dynamic_cast<Get*>(callee);
+
+      return call;
     }
 
     // Function equivalent to the "call" rule.
     // This works in a left-associative way. Think of the following chaining of functions: f(1)(2)(3)
-    std::shared_ptr<Expr> call(){
-      std::shared_ptr<Expr> expr = primary();
+    Expr* call(){
+      Expr* expr = primary();
 
       while(true){
         if(match(TokenType::LEFT_PAREN)){
           expr = finishCall(expr);
         }else if(match(TokenType::DOT)){
           Token name = consume(TokenType::IDENTIFIER, "After '.' expect a property name.");
-          expr = std::make_shared<Get>(std::move(name), expr);
+          expr = arena.make<Get>(std::move(name), expr);
         }else{
           break;
         }
@@ -433,34 +444,36 @@ class Parser{
     // It's the highest precedence rule of the Lox Context-Free Grammar.
     // Pay attention to the fact that you can nest expressions if higher precedence by using parenthesis.
     // In that way, this method matches an unary operator or anything of higher precedence.
-    std::shared_ptr<Expr> primary(){
+    Expr* primary(){
 
       if(match(TokenType::NIL))
-        return std::make_shared<Literal>(nullptr);
+        return arena.make<Literal>(nullptr);
       if(match(TokenType::TRUE))
-        return std::make_shared<Literal>(true);
+        return arena.make<Literal>(true);
       if(match(TokenType::FALSE))
-        return std::make_shared<Literal>(false);
-      if(match(TokenType::NUMBER, TokenType::STRING))
-        return std::make_shared<Literal>(previous().literal);
+        return arena.make<Literal>(false);
+      if(match(TokenType::NUMBER))
+        return arena.make<Literal>(previous().number);
+      if(match(TokenType::STRING))
+        return arena.make<Literal>(Value{previous().symbol});
       if(match(TokenType::LEFT_PAREN)){
-        std::shared_ptr<Expr> expr = expression();
+        Expr* expr = expression();
         consume(TokenType::RIGHT_PAREN, "Expected ')' after expression.");
         
-        return std::make_shared<Grouping>(expr);
+        return arena.make<Grouping>(expr);
       }
       if(match(TokenType::SUPER)){
         Token keyword = previous();
         consume(TokenType::DOT, "Expect a '.' after 'super'.");
         Token method = consume(TokenType::IDENTIFIER, "Expect a superclass method name.");
         
-        return std::make_shared<Super>(std::move(keyword), std::move(method));
+        return arena.make<Super>(std::move(keyword), std::move(method));
       }
       if(match(TokenType::THIS)){
-        return std::make_shared<This>(previous());
+        return arena.make<This>(previous());
       }
       if(match(TokenType::IDENTIFIER)){
-        return std::make_shared<Variable>(previous());
+        return arena.make<Variable>(previous());
       }
 
       throw error(peek(), "Expect an expression.");
@@ -538,7 +551,10 @@ class Parser{
 
     // Function that consumes the current token that has not been consumed yet and returns it.
     Token advance(){
-      if(!isAtEnd()) current++;
+      if(!isAtEnd()){
+        last = current;
+        current = scanner.nextToken();
+      }
       return previous();
     }
 
@@ -548,23 +564,23 @@ class Parser{
     }
 
     // Function that returns the current token that has not been consumed yet.
-    Token peek(){
-      return tokens[current];
+    const Token& peek(){
+      return current;
     }
 
     // Function that returns the most recently consumed token by the parser.
     // Such function makes it easier to use match() and then access the just-matched token.
-    Token previous(){
-      return tokens[current - 1];
+    const Token& previous(){
+      return last;
     }
 
   public:
-    Parser(const std::vector<Token>& tokens)
-      : tokens{tokens}
+    Parser(Scanner& scanner, Arena& arena)
+      : scanner{scanner}, arena{arena}, current{scanner.nextToken()}, last{current}
     {}
 
-    std::vector<std::shared_ptr<Stmt>> parse(){
-      std::vector<std::shared_ptr<Stmt>> statements;
+    std::vector<Stmt*> parse(){
+      std::vector<Stmt*> statements;
 
       while(!isAtEnd()){
         statements.push_back(declaration());
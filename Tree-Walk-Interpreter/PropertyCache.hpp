@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Shape.hpp"
+
+// Inline cache attached to each property access ('Get' and 'Set' nodes), shared by the Interpreter and the VM.
+// It remembers the slot the property had for the last few shapes seen at that access, so once it's warmed up
+// reading a field is a shape compare plus an indexed load. Most accesses only ever see one shape (monomorphic),
+// but up to SIZE of them are kept (polymorphic). Accesses that see more than that just stop caching new shapes.
+struct PropertyCache{
+  static constexpr int SIZE = 4;
+
+  struct Entry{
+    Shape* shape;      // Shape of the instance before the access.
+    Shape* transition; // For a 'Set' that adds the field: the shape the instance moves to. Null otherwise.
+    int slot;
+  };
+
+  Entry entries[SIZE];
+  int count = 0;
+
+  const Entry* find(const Shape* shape) const{
+    for(int i = 0; i < count; i++){
+      if(entries[i].shape == shape) return &entries[i];
+    }
+
+    return nullptr;
+  }
+
+  void add(const Entry& entry){
+    if(count < SIZE){
+      entries[count++] = entry;
+    }
+
+    return;
+  }
+};
@@ -1,6 +1,5 @@
 #pragma once
 
-#include <any>
 #include <cassert>
 #include <memory>
 #include <iostream>
@@ -9,12 +8,14 @@
 #include <type_traits>
 
 #include "Expr.hpp"
+#include "Value.hpp"
+#include "LoxString.hpp"
 
 class RPNPrinter : public ExprVisitor{
   private:
     template <class... E>
     std::string rpn(std::string_view name, E... expr){
-      assert((... && std::is_same_v<E, std::shared_ptr<Expr>>));
+      assert((... && std::is_same_v<E, Expr*>));
 
       std::ostringstream builder;
 
@@ -25,35 +26,35 @@ class RPNPrinter : public ExprVisitor{
       return builder.str();
     }
   public:
-    std::string print(std::shared_ptr<Expr> expr){
-      return std::any_cast<std::string>(expr->accept(*this));
+    std::string print(Expr* expr){
+      return expr->accept(*this).asObject<LoxString>()->toString();
     }
 
-    std::any visitBinaryExpr(std::shared_ptr<Binary> expr) override{
-      return rpn(expr->op.lexeme, expr->left, expr->right);
+    Value visitBinaryExpr(Binary* expr) override{
+      return makeString(rpn(expr->op.lexeme, expr->left, expr->right));
     }
 
-    std::any visitUnaryExpr(std::shared_ptr<Unary> expr) override{
-      return rpn(expr->op.lexeme, expr->right);
+    Value visitUnaryExpr(Unary* expr) override{
+      return makeString(rpn(expr->op.lexeme, expr->right));
     }
 
-    std::any visitLiteralExpr(std::shared_ptr<Literal> expr) override{
-      auto& expr_type = expr->value.type();
-
-      if(expr_type == typeid(nullptr)){
-        return "nil";
-      }else if(expr_type == typeid(std::string)){
-        return std::any_cast<std::string>(expr->value);
-      }else if(expr_type == typeid(double)){
-        return std::to_string(std::any_cast<double>(expr->value));
-      }else if(expr_type == typeid(bool)){
-        return std::any_cast<bool>(expr->value) ? "true" : "false";
+    Value visitLiteralExpr(Literal* expr) override{
+      const Value& value = expr->value;
+
+      if(value.isNil()){
+        return makeString("nil");
+      }else if(value.isString()){
+        return value;
+      }else if(value.isNumber()){
+        return makeString(std::to_string(value.asNumber()));
+      }else if(value.isBool()){
+        return makeString(value.asBool() ? "true" : "false");
       }
 
-      return "Error in visitLiteralExpr: Literal type not recognized.";
+      return makeString("Error in visitLiteralExpr: Literal type not recognized.");
     }
 
-    std::any visitGroupingExpr(std::shared_ptr<Grouping> expr) override{
-      return rpn("grouping", expr->expression);
+    Value visitGroupingExpr(Grouping* expr) override{
+      return makeString(rpn("grouping", expr->expression));
     }
 };
\ No newline at end of file
@@ -1,20 +1,22 @@
 #include "RPNPrinter.hpp"
+#include "Arena.hpp"
 
 int main(){
-  std::shared_ptr<Expr> expression = std::make_shared<Binary>(
-    std::make_shared<Grouping>(
-      std::make_shared<Binary>(
-        std::make_shared<Literal>(1.0),
-        Token(1, TokenType::PLUS, nullptr, "+"),
-        std::make_shared<Literal>(2.0)
+  Arena arena;
+  Expr* expression = arena.make<Binary>(
+    arena.make<Grouping>(
+      arena.make<Binary>(
+        arena.make<Literal>(1.0),
+        Token(1, TokenType::PLUS, "+"),
+        arena.make<Literal>(2.0)
       )
     ),
-    Token(1, TokenType::STAR, nullptr, "*"),
-    std::make_shared<Grouping>(
-      std::make_shared<Binary>(
-        std::make_shared<Literal>(4.0),
-        Token(1, TokenType::MINUS, nullptr, "-"),
-        std::make_shared<Literal>(3.0)
+    Token(1, TokenType::STAR, "*"),
+    arena.make<Grouping>(
+      arena.make<Binary>(
+        arena.make<Literal>(4.0),
+        Token(1, TokenType::MINUS, "-"),
+        arena.make<Literal>(3.0)
       )
     )
   );
@@ -3,14 +3,39 @@
 #include <map>
 #include <memory>
 #include <vector>
+#include <algorithm>
+#include <string_view>
 #include <functional>
+#include <unordered_set>
 
-#include "Interpreter.hpp"
+#include "Expr.hpp"
+#include "Stmt.hpp"
+#include "Error.hpp"
 
 class Resolver : public ExprVisitor, public StmtVisitor{
   private:
-    Interpreter& interpreter;
-    std::vector<std::map<std::string, bool>> scopes;
+    // For each local variable, whether its initializer has already been resolved and the slot it occupies inside its Environment
+    // (or inside its frame, for scopes on the value stack).
+    struct LocalVariable{
+      bool defined;
+      int slot;
+      Stmt* declaration = nullptr; // The 'var' or 'fun' statement that declared it (null for parameters, 'this' and 'super').
+      bool used = false;           // Whether any expression refers to it.
+    };
+
+    struct Scope{
+      std::map<std::string_view, LocalVariable> variables;
+      bool onStack = false; // Nothing declared inside can capture it, so its variables live on the value stack instead of an Environment.
+      int base = 0;         // For scopes on the stack: frame slot of the first variable. Nested blocks share their function's frame.
+    };
+
+    // Scopes on the stack can only contain more scopes on the stack, so they are always the innermost ones.
+    std::vector<Scope> scopes;
+    int frameSize = 0; // Slots used so far by the frame being resolved.
+
+    // Local 'var' and 'fun' declarations that nothing refers to. The DeadCodeEliminator removes them.
+    std::unordered_set<Stmt*> unused;
+    std::vector<Function*> functions; // The functions whose bodies are being resolved. Calling itself doesn't make a function used.
 
     enum class FunctionType{
       NONE,
@@ -28,68 +53,146 @@ class Resolver : public ExprVisitor, public StmtVisitor{
     FunctionType currentFunction = FunctionType::NONE;
     ClassType currentClass = ClassType::NONE;
 
-    void resolve(std::shared_ptr<Stmt> stmt){
+    void resolve(Stmt* stmt){
       // Very similar to the "execute" method from the Interpreter class.
       stmt->accept(*this);
 
       return;
     }
 
-    void resolve(std::shared_ptr<Expr> expr){
+    void resolve(Expr* expr){
       // Very similar to the "evaluate" method from the Interpreter class.
       expr->accept(*this);
 
       return;
     }
 
-    void resolveFunction(std::shared_ptr<Function> function, FunctionType type){
+    void resolveFunction(Function* function, FunctionType type){
       FunctionType enclosingFunction = currentFunction;
       currentFunction = type;
 
-      beginScope();
+      // Escape analysis: the variables of a function can only outlive the call if a function or class declared inside
+      // closes over them. Otherwise the whole body, nested blocks included, gets a single frame on the value stack.
+      int enclosingFrameSize = frameSize;
+      frameSize = 0;
+      function->onStack = !declaresClosure(function->body);
+
+      functions.push_back(function);
+      beginScope(function->onStack);
+      if(type == FunctionType::METHOD || type == FunctionType::INITIALIZER){
+        // Methods get their receiver in slot 0 of their own scope, right before the parameters.
+        addVariable("this", true);
+      }
       for(const Token& param : function->parameters){
         declare(param);
         define(param);
       }
       resolve(function->body);
       endScope();
+      functions.pop_back();
 
+      if(function->onStack) function->frameSize = frameSize;
+      frameSize = enclosingFrameSize;
       currentFunction = enclosingFunction;
 
       return;
     }
 
-    void resolveLocal(std::shared_ptr<Expr> expr, const Token& name){
+    // Whether any of the statements (at any depth) declares a function or a class. Those are the only way to capture a scope in Lox.
+    static bool declaresClosure(const std::vector<Stmt*>& statements){
+      for(Stmt* statement : statements){
+        if(declaresClosure(statement)) return true;
+      }
+
+      return false;
+    }
+
+    static bool declaresClosure(Stmt* statement){
+      if(dynamic_cast<Function*>(statement) != nullptr || dynamic_cast<Class*>(statement) != nullptr){
+        return true;
+      }
+      if(auto block = dynamic_cast<Block*>(statement)){
+        return declaresClosure(block->statements);
+      }
+      if(auto branch = dynamic_cast<If*>(statement)){
+        return declaresClosure(branch->ifBranch) || (branch->elseBranch != nullptr && declaresClosure(branch->elseBranch));
+      }
+      if(auto loop = dynamic_cast<While*>(statement)){
+        return declaresClosure(loop->body);
+      }
+
+      return false;
+    }
+
+    // Records where the variable lives directly in the expression node, so the Interpreter doesn't have to search for it.
+    // Scopes on the stack have no Environment, so they don't count towards the depth of the ones that do.
+    void resolveLocal(LocalSlot& local, std::string_view name){
+      int depth = 0;
       for(int i = scopes.size() - 1; i >= 0 ; i--){
-        if(scopes[i].find(name.lexeme) != scopes[i].end()){
-          interpreter.resolve(expr, scopes.size() - 1 - i);
+        auto elem = scopes[i].variables.find(name);
+        if(elem != scopes[i].variables.end()){
+          local.depth = scopes[i].onStack ? 0 : depth;
+          local.slot = elem->second.slot;
+          local.onStack = scopes[i].onStack;
+          if(std::find(functions.begin(), functions.end(), elem->second.declaration) == functions.end()){
+            elem->second.used = true;
+          }
           return;
         }
+        if(!scopes[i].onStack) depth++;
       }
 
       return;
     }
 
-    void beginScope(){
-      scopes.push_back(std::map<std::string, bool>{});
+    void beginScope(bool onStack = false){
+      Scope scope;
+      scope.onStack = onStack;
+      if(onStack && !scopes.empty() && scopes.back().onStack){
+        scope.base = scopes.back().base + scopes.back().variables.size();
+      }
+      scopes.push_back(std::move(scope));
 
       return;
     }
 
     void endScope(){
+      for(const auto& [name, variable] : scopes.back().variables){
+        if(variable.declaration != nullptr && !variable.used){
+          unused.insert(variable.declaration);
+        }
+      }
       scopes.pop_back();
 
       return;
     }
 
-    void declare(const Token& name){
-      if(scopes.empty()) return;
+    // Gives the variable the next free slot of the innermost scope and returns it.
+    int addVariable(std::string_view name, bool defined){
+      Scope& scope = scopes.back();
+      int slot = scope.base + scope.variables.size();
+      scope.variables[name] = LocalVariable{defined, slot};
+      if(scope.onStack && slot + 1 > frameSize){
+        frameSize = slot + 1;
+      }
+
+      return slot;
+    }
 
-      std::map<std::string, bool>& scope = scopes.back();
-      if(scope.find(name.lexeme) != scope.end()){
+    int declare(const Token& name){
+      if(scopes.empty()) return 0;
+
+      if(scopes.back().variables.find(name.lexeme) != scopes.back().variables.end()){
         error(name, "Already a variable with this name in this scope.");
       }
-      scope[name.lexeme] = false;
+
+      return addVariable(name.lexeme, false);
+    }
+
+    void recordDeclaration(const Token& name, Stmt* declaration){
+      if(scopes.empty()) return; // Globals are late-bound: code that runs later may still use them.
+
+      scopes.back().variables[name.lexeme].declaration = declaration;
 
       return;
     }
@@ -97,35 +200,58 @@ class Resolver : public ExprVisitor, public StmtVisitor{
     void define(const Token& name){
       if(scopes.empty()) return;
 
-      scopes.back()[name.lexeme] = true;
+      scopes.back().variables[name.lexeme].defined = true;
 
       return;
     }
 
   public:
-    Resolver(Interpreter& interpreter)
-      : interpreter{interpreter}
-    {}
+    const std::unordered_set<Stmt*>& unusedDeclarations() const{
+      return unused;
+    }
 
-    void resolve(const std::vector<std::shared_ptr<Stmt>>& statements){
-      for(const std::shared_ptr<Stmt>& statement : statements){
+    void resolve(const std::vector<Stmt*>& statements){
+      for(Stmt* statement : statements){
         resolve(statement);
       }
       return;
     }
 
-    std::any visitBlockStmt(std::shared_ptr<Block> stmt) override{
+    void visitBlockStmt(Block* stmt) override{
+      stmt->onStack = false; // The tree may be resolved again after it's optimized.
+      stmt->frameSize = 0;
+
       // This begins a new scope, 
       // traverses into the statements inside the block, 
       // and then discards the scope.
-      beginScope();
-      resolve(stmt->statements);
-      endScope();
+      if(!scopes.empty() && scopes.back().onStack){
+        // Already inside a frame on the stack: the block's variables just take the next slots of that frame.
+        stmt->onStack = true;
+        beginScope(true);
+        resolve(stmt->statements);
+        endScope();
+      }else if(!declaresClosure(stmt->statements)){
+        // The outermost block that nothing can capture starts a frame of its own.
+        int enclosingFrameSize = frameSize;
+        frameSize = 0;
+
+        stmt->onStack = true;
+        beginScope(true);
+        resolve(stmt->statements);
+        endScope();
 
-      return {};
+        stmt->frameSize = frameSize;
+        frameSize = enclosingFrameSize;
+      }else{
+        beginScope();
+        resolve(stmt->statements);
+        endScope();
+      }
+
+      return;
     }
 
-    std::any visitClassStmt(std::shared_ptr<Class> stmt) override{
+    void visitClassStmt(Class* stmt) override{
       ClassType enclosingClass = currentClass;
       currentClass = ClassType::CLASS;
 
@@ -143,13 +269,10 @@ class Resolver : public ExprVisitor, public StmtVisitor{
 
       if(stmt->superclass != nullptr){
         beginScope();
-        scopes.back()["super"] = true;
+        addVariable("super", true);
       }
-      
-      beginScope();
-      scopes.back()["this"] = true;
 
-      for(std::shared_ptr<Function> method : stmt->methods){
+      for(Function* method : stmt->methods){
         FunctionType declaration = FunctionType::METHOD;
         if(method->name.lexeme == "init"){
           declaration = FunctionType::INITIALIZER;
@@ -157,32 +280,31 @@ class Resolver : public ExprVisitor, public StmtVisitor{
         resolveFunction(method, declaration);
       }
 
-      endScope();
-
       if(stmt->superclass != nullptr){
         endScope();
       }
 
       currentClass = enclosingClass;
 
-      return {};
+      return;
     }
 
-    std::any visitExpressionStmt(std::shared_ptr<Expression> stmt) override{
+    void visitExpressionStmt(Expression* stmt) override{
       resolve(stmt->expression);
 
-      return {};
+      return;
     }
 
-    std::any visitFunctionStmt(std::shared_ptr<Function> stmt) override{
+    void visitFunctionStmt(Function* stmt) override{
       declare(stmt->name);
       define(stmt->name);
+      recordDeclaration(stmt->name, stmt);
 
       resolveFunction(stmt, FunctionType::FUNCTION);
-      return {};
+      return;
     }
 
-    std::any visitIfStmt(std::shared_ptr<If> stmt) override{
+    void visitIfStmt(If* stmt) override{
       resolve(stmt->condition);
       resolve(stmt->ifBranch);
 
@@ -190,16 +312,16 @@ class Resolver : public ExprVisitor, public StmtVisitor{
         resolve(stmt->elseBranch);
       }
 
-      return {};
+      return;
     }
 
-    std::any visitPrintStmt(std::shared_ptr<Print> stmt) override{
+    void visitPrintStmt(Print* stmt) override{
       resolve(stmt->expression);
 
-      return {};
+      return;
     }
 
-    std::any visitReturnStmt(std::shared_ptr<Return> stmt) override{
+    void visitReturnStmt(Return* stmt) override{
       if(currentFunction == FunctionType::NONE){
         error(stmt->keyword, "Can't return from top-level code.");
       }
@@ -211,116 +333,121 @@ class Resolver : public ExprVisitor, public StmtVisitor{
         resolve(stmt->value);
       }
 
-      return {};
+      return;
     }
 
-    std::any visitVarStmt(std::shared_ptr<Var> stmt) override{
-      declare(stmt->name);
+    void visitVarStmt(Var* stmt) override{
+      if(!scopes.empty()){
+        stmt->local.onStack = scopes.back().onStack;
+      }
+      stmt->local.slot = declare(stmt->name);
       if(stmt->initializer != nullptr){
         resolve(stmt->initializer);
       }
       define(stmt->name);
+      recordDeclaration(stmt->name, stmt);
 
-      return {};
+      return;
     }
 
-    std::any visitWhileStmt(std::shared_ptr<While> stmt) override{
+    void visitWhileStmt(While* stmt) override{
       resolve(stmt->condition);
       resolve(stmt->body);
 
-      return {};
+      return;
     }
 
-    std::any visitAssignExpr(std::shared_ptr<Assign> expr) override{
+    Value visitAssignExpr(Assign* expr) override{
       resolve(expr->value);
-      resolveLocal(expr, expr->name);
+      resolveLocal(expr->local, expr->name.lexeme);
 
       return {};
     }
 
-    std::any visitBinaryExpr(std::shared_ptr<Binary> expr) override{
+    Value visitBinaryExpr(Binary* expr) override{
       resolve(expr->left);
       resolve(expr->right);
 
       return {};
     }
 
-    std::any visitCallExpr(std::shared_ptr<Call> expr) override{
+    Value visitCallExpr(Call* expr) override{
       resolve(expr->callee);
 
-      for(const std::shared_ptr<Expr>& argument : expr->arguments){
+      for(Expr* argument : expr->arguments){
         resolve(argument);
       }
 
       return {};
     }
 
-    std::any visitGetExpr(std::shared_ptr<Get> expr) override{
+    Value visitGetExpr(Get* expr) override{
       resolve(expr->object);
 
       return {};
     }
 
-    std::any visitGroupingExpr(std::shared_ptr<Grouping> expr) override{
+    Value visitGroupingExpr(Grouping* expr) override{
       resolve(expr->expression);
 
       return {};
     }
 
-    std::any visitLiteralExpr(std::shared_ptr<Literal> expr) override{
+    Value visitLiteralExpr(Literal* expr) override{
       return {};
     }
 
-    std::any visitLogicalExpr(std::shared_ptr<Logical> expr) override{
+    Value visitLogicalExpr(Logical* expr) override{
       resolve(expr->left);
       resolve(expr->right);
 
       return {};
     }
 
-    std::any visitSetExpr(std::shared_ptr<Set> expr) override{
+    Value visitSetExpr(Set* expr) override{
       resolve(expr->value);
       resolve(expr->object);
 
       return {};
     }
 
-    std::any visitSuperExpr(std::shared_ptr<Super> expr) override{
+    Value visitSuperExpr(Super* expr) override{
       if(currentClass == ClassType::NONE){
         error(expr->keyword, "Can't use 'super' outside of a class.");
       }else if(currentClass != ClassType::SUBCLASS){
         error(expr->keyword, "Can't use 'super' inside a class with no superclass.");
       }
-      resolveLocal(expr, expr->keyword);
+      resolveLocal(expr->local, expr->keyword.lexeme);
+      resolveLocal(expr->thisLocal, "this");
 
       return {};
     }
 
-    std::any visitThisExpr(std::shared_ptr<This> expr) override{
+    Value visitThisExpr(This* expr) override{
       if(currentClass == ClassType::NONE){
         error(expr->keyword, "Can't use 'this' outside of a class.");
         return {};
       }
-      resolveLocal(expr, expr->keyword);
+      resolveLocal(expr->local, expr->keyword.lexeme);
 
       return{};
     }
 
-    std::any visitUnaryExpr(std::shared_ptr<Unary> expr) override{
+    Value visitUnaryExpr(Unary* expr) override{
       resolve(expr->right);
       
       return {};
     }
 
-    std::any visitVariableExpr(std::shared_ptr<Variable> expr) override{
+    Value visitVariableExpr(Variable* expr) override{
       if(!scopes.empty()){
-        auto& scope = scopes.back();
+        auto& scope = scopes.back().variables;
         auto elem = scope.find(expr->name.lexeme);
-        if(elem != scope.end() && elem->second == false){
+        if(elem != scope.end() && elem->second.defined == false){
           error(expr->name, "Can't read local variable in its own initializer.");
         }
       }
-      resolveLocal(expr, expr->name);
+      resolveLocal(expr->local, expr->name.lexeme);
 
       return {};
     }
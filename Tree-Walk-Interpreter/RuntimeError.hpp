@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <stdexcept>
 
 #include "Token.hpp"
@@ -11,4 +12,12 @@ class RuntimeError : public std::runtime_error{
     RuntimeError(const Token& token, std::string_view message)
       : std::runtime_error{message.data()}, token{token} 
     {}
+};
+
+// Thrown by native functions, which don't know where they were called from. The call turns it into a RuntimeError at the call site.
+class NativeError : public std::runtime_error{
+  public:
+    NativeError(const std::string& message)
+      : std::runtime_error{message}
+    {}
 };
\ No newline at end of file
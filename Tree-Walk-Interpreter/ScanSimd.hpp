@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Bulk helpers for the Scanner's inner loops: whitespace runs, comment lines and string bodies.
+// With AVX2 (or SSE2) they look at 32 (or 16) bytes per step: each byte is compared against the characters
+// we're looking for and the results are turned into a bit mask, so finding the first match is a single 'count trailing zeros'
+// and counting newlines is a single 'popcount'. Whatever is left at the end of the source (or everything, on other targets) goes
+// through the plain byte-by-byte loops.
+
+#if defined(__AVX2__)
+  #define LOX_SIMD
+  using SimdBlock = __m256i;
+  using SimdMask = uint32_t;
+  constexpr std::ptrdiff_t SIMD_WIDTH = 32;
+  constexpr SimdMask SIMD_FULL_MASK = 0xffffffff;
+
+  inline SimdBlock loadBlock(const char* bytes){
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes));
+  }
+
+  inline SimdMask matchMask(SimdBlock block, char c){
+    return static_cast<SimdMask>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(c))));
+  }
+#elif defined(__SSE2__)
+  #define LOX_SIMD
+  using SimdBlock = __m128i;
+  using SimdMask = uint32_t;
+  constexpr std::ptrdiff_t SIMD_WIDTH = 16;
+  constexpr SimdMask SIMD_FULL_MASK = 0xffff;
+
+  inline SimdBlock loadBlock(const char* bytes){
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+  }
+
+  inline SimdMask matchMask(SimdBlock block, char c){
+    return static_cast<SimdMask>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(c))));
+  }
+#endif
+
+// Returns the first character in [current, end) that isn't a space, tab, carriage return or newline,
+// adding the newlines it skipped over to 'line'.
+inline const char* skipWhitespace(const char* current, const char* end, int& line){
+#ifdef LOX_SIMD
+  while(end - current >= SIMD_WIDTH){
+    SimdBlock block = loadBlock(current);
+    SimdMask newlines = matchMask(block, '\n');
+    SimdMask blanks = newlines | matchMask(block, ' ') | matchMask(block, '\t') | matchMask(block, '\r');
+
+    if(blanks != SIMD_FULL_MASK){
+      int length = __builtin_ctz(~blanks);
+      line += __builtin_popcount(newlines & ((SimdMask{1} << length) - 1));
+      return current + length;
+    }
+
+    line += __builtin_popcount(newlines);
+    current += SIMD_WIDTH;
+  }
+#endif
+
+  while(current < end && (*current == ' ' || *current == '\t' || *current == '\r' || *current == '\n')){
+    if(*current == '\n') line++;
+    current++;
+  }
+
+  return current;
+}
+
+// Returns the newline that ends the comment starting at 'current' (or 'end', if the comment is on the last line).
+inline const char* findLineEnd(const char* current, const char* end){
+#ifdef LOX_SIMD
+  while(end - current >= SIMD_WIDTH){
+    SimdMask newlines = matchMask(loadBlock(current), '\n');
+    if(newlines != 0){
+      return current + __builtin_ctz(newlines);
+    }
+
+    current += SIMD_WIDTH;
+  }
+#endif
+
+  while(current < end && *current != '\n') current++;
+
+  return current;
+}
+
+// Returns the closing '"' of the string literal whose body starts at 'current' (or 'end', if it's unterminated),
+// adding the newlines inside the string to 'line'.
+inline const char* findStringEnd(const char* current, const char* end, int& line){
+#ifdef LOX_SIMD
+  while(end - current >= SIMD_WIDTH){
+    SimdBlock block = loadBlock(current);
+    SimdMask newlines = matchMask(block, '\n');
+    SimdMask quotes = matchMask(block, '"');
+
+    if(quotes != 0){
+      int length = __builtin_ctz(quotes);
+      line += __builtin_popcount(newlines & ((SimdMask{1} << length) - 1));
+      return current + length;
+    }
+
+    line += __builtin_popcount(newlines);
+    current += SIMD_WIDTH;
+  }
+#endif
+
+  while(current < end && *current != '"'){
+    if(*current == '\n') line++;
+    current++;
+  }
+
+  return current;
+}
@@ -1,13 +1,16 @@
 #pragma once
 
-#include <map>
 #include <string>
 #include <vector>
+#include <cstdlib> // std::strtod
+#include <optional>
 #include <utility>
+#include <charconv>
 #include <string_view>
 
 #include "Error.hpp"
 #include "Token.hpp"
+#include "ScanSimd.hpp"
 
 class Scanner{
   public:
@@ -15,40 +18,38 @@ class Scanner{
     int start = 0;
     int current = 0;
     std::string_view source;
-    std::vector<Token> tokens;
-    std::map<std::string, TokenType> keywords = {
-        {"and",    TokenType::AND},
-        {"class",  TokenType::CLASS},
-        {"else",   TokenType::ELSE},
-        {"false",  TokenType::FALSE},
-        {"for",    TokenType::FOR},
-        {"fun",    TokenType::FUN},
-        {"if",     TokenType::IF},
-        {"nil",    TokenType::NIL},
-        {"or",     TokenType::OR},
-        {"print",  TokenType::PRINT},
-        {"return", TokenType::RETURN},
-        {"super",  TokenType::SUPER},
-        {"this",   TokenType::THIS},
-        {"true",   TokenType::TRUE},
-        {"var",    TokenType::VAR},
-        {"while",  TokenType::WHILE},
-    };
+    std::optional<Token> scanned; // Set by addToken when scanToken produces a token (whitespace and comments don't).
 
     Scanner(std::string_view source)
       : source(std::move(source))
     {}
 
-    // Method that scans the whole source code and returns a sequence of tokens.
-    std::vector<Token> scanTokens(){
+    // Method that scans and returns the next token, so the Parser can pull tokens as it needs them
+    // instead of keeping the whole sequence in memory. Once the source is exhausted it keeps returning FILE_END.
+    Token nextToken(){
       while(!isAtEnd()){
-          // We are at the beginning of the next lexeme.
-          // In each iteration/turn of the loop, a single token is scanned.
-          start = current;
-          scanToken();
+        // We are at the beginning of the next lexeme.
+        // In each iteration/turn of the loop, a single token is scanned.
+        start = current;
+        scanToken();
+
+        if(scanned.has_value()){
+          Token token = *scanned;
+          scanned.reset();
+          return token;
+        }
       }
 
-      tokens.push_back(Token(line, TokenType::FILE_END, nullptr, ""));
+      return Token(line, TokenType::FILE_END, "");
+    }
+
+    // Method that scans the whole source code and returns a sequence of tokens.
+    std::vector<Token> scanTokens(){
+      std::vector<Token> tokens;
+      do{
+        tokens.push_back(nextToken());
+      }while(tokens.back().type != TokenType::FILE_END);
+
       return tokens;
     }
 
@@ -62,15 +63,18 @@ class Scanner{
       return source[current++];
     }
 
-    // Auxiliar method to add a token to the list of tokens produced by the Scanner.
+    // Method that creates the current token (generated from the current lexeme) and hands it to nextToken.
+    // The lexeme is only a view into the source, so no memory is allocated per token.
     void addToken(TokenType type){
-      addToken(type, nullptr);
+      scanned.emplace(line, type, source.substr(start, current - start));
+
+      return;
     }
 
-    // Method that creates and adds the current token (generated from the current lexeme) to the list of tokens produced by the Scanner.
-    void addToken(TokenType type, std::any literal){
-      std::string lexeme{source.substr(start, current - start)};
-      tokens.push_back(Token(line, type, literal, lexeme));
+    // Same as above, for tokens that carry a literal value (numbers and strings).
+    template<class Literal>
+    void addToken(TokenType type, Literal literal){
+      scanned.emplace(line, type, source.substr(start, current - start), literal);
 
       return;
     }
@@ -123,21 +127,24 @@ class Scanner{
           break;
         case '/':
           if(match('/')){
-              // It's a comment.
-              while(peek() != '\n' && !isAtEnd()) advance();
+              // It's a comment. Jump straight to the newline that ends it.
+              current = findLineEnd(source.data() + current, source.data() + source.length()) - source.data();
           }else{
               // It's the division operator '/'.
               addToken(TokenType::SLASH);
           }
           break;
         case ' ':
-          break;
         case '\r':
-          break;
         case '\t':
-          break;
         case '\n':
-          line++;
+          if(c == '\n') line++;
+
+          // Whitespace tends to come in runs (indentation, blank lines), so the rest of the run is skipped at once.
+          // A single space between two tokens is the most common case, though, and isn't worth a wide load.
+          if(isWhitespace(peek())){
+            current = skipWhitespace(source.data() + current, source.data() + source.length(), line) - source.data();
+          }
           break;
         case '"':
           string();
@@ -159,19 +166,59 @@ class Scanner{
     void identifier(){
       while(isAlphaNumeric(peek())) advance();
 
-      TokenType type;
-      std::string lexeme = std::string{source.substr(start, current - start)};
-      if(keywords.find(lexeme) != keywords.end()){
-        type = keywords[lexeme];
+      std::string_view text = source.substr(start, current - start);
+      TokenType type = keywordType(text);
+      if(type == TokenType::IDENTIFIER){
+        addToken(type, intern(text));
       }else{
-        type = TokenType::IDENTIFIER;
+        addToken(type);
       }
 
-      addToken(type);
-
       return;
     }
 
+    // Method that classifies an identifier as one of the reserved words (or as a plain identifier).
+    // It's a hand-written trie: the first letter (and the second one, when several keywords share the first) picks
+    // the only keyword the text could be, and then the rest is compared directly. No strings and no lookups in a map.
+    static constexpr TokenType keywordType(std::string_view text){
+      switch(text[0]){
+        case 'a': return checkKeyword(text, "and", TokenType::AND);
+        case 'c': return checkKeyword(text, "class", TokenType::CLASS);
+        case 'e': return checkKeyword(text, "else", TokenType::ELSE);
+        case 'f':
+          if(text.length() > 1){
+            switch(text[1]){
+              case 'a': return checkKeyword(text, "false", TokenType::FALSE);
+              case 'o': return checkKeyword(text, "for", TokenType::FOR);
+              case 'u': return checkKeyword(text, "fun", TokenType::FUN);
+            }
+          }
+          break;
+        case 'i': return checkKeyword(text, "if", TokenType::IF);
+        case 'n': return checkKeyword(text, "nil", TokenType::NIL);
+        case 'o': return checkKeyword(text, "or", TokenType::OR);
+        case 'p': return checkKeyword(text, "print", TokenType::PRINT);
+        case 'r': return checkKeyword(text, "return", TokenType::RETURN);
+        case 's': return checkKeyword(text, "super", TokenType::SUPER);
+        case 't':
+          if(text.length() > 1){
+            switch(text[1]){
+              case 'h': return checkKeyword(text, "this", TokenType::THIS);
+              case 'r': return checkKeyword(text, "true", TokenType::TRUE);
+            }
+          }
+          break;
+        case 'v': return checkKeyword(text, "var", TokenType::VAR);
+        case 'w': return checkKeyword(text, "while", TokenType::WHILE);
+      }
+
+      return TokenType::IDENTIFIER;
+    }
+
+    static constexpr TokenType checkKeyword(std::string_view text, std::string_view keyword, TokenType type){
+      return text == keyword ? type : TokenType::IDENTIFIER;
+    }
+
     // Method that adds a number (integer or floating-point) token.
     void number(){
       while(isDigit(peek())) advance();
@@ -184,18 +231,29 @@ class Scanner{
         while(isDigit(peek())) advance();
       }
 
-      addToken(TokenType::NUMBER, std::stod(std::string{source.substr(start, current - start)}));
+      addToken(TokenType::NUMBER, parseNumber(source.substr(start, current - start)));
 
       return;
     }
 
+    // Converts the digits of a number lexeme without copying them into a temporary string first (as std::stod would need).
+    double parseNumber(std::string_view digits){
+      double value = 0;
+      auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+
+      // from_chars leaves 'value' alone when the number is too large or too small for a double. std::strtod rounds it like
+      // Java's Double.parseDouble does instead: to infinity, or to a subnormal number or 0. It's rare enough to pay for the copy.
+      if(error == std::errc::result_out_of_range){
+        value = std::strtod(std::string{digits}.c_str(), nullptr);
+      }
+
+      return value;
+    }
+
     // Method that adds a string literal token.
     // Note that Lox does not support escape sequences like '\n'. If that was the case, we would unescape those.
     void string(){
-      while(peek() != '"' && !isAtEnd()){
-        if(peek() == '\n') line++;
-        advance();
-      }
+      current = findStringEnd(source.data() + current, source.data() + source.length(), line) - source.data();
 
       if(isAtEnd()){
         error(line, "Unterminated string.");
@@ -205,8 +263,7 @@ class Scanner{
       // Close the '"' character.
       advance();
 
-      std::string literal = std::string{source.substr(start + 1, current - start - 2)};
-      addToken(TokenType::STRING, literal);
+      addToken(TokenType::STRING, intern(source.substr(start + 1, current - start - 2)));
 
       return;
     }
@@ -237,6 +294,11 @@ class Scanner{
       return source[current + 1];
     }
 
+    // Method that checks whether the received character is a space, a tab, a carriage return or a newline.
+    bool isWhitespace(char c){
+      return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
     // Method that checks whether the received character is a letter or an underscore.
     bool isAlpha(char c){
       return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c == '_');
@@ -252,4 +314,16 @@ class Scanner{
     bool isDigit(char c){
       return (c >= '0' && c <= '9');
     }
-};
\ No newline at end of file
+};
+
+// The recognizer runs at compile time too, so a typo in the trie breaks the build instead of silently turning a keyword into an identifier.
+static_assert(Scanner::keywordType("and") == TokenType::AND && Scanner::keywordType("class") == TokenType::CLASS);
+static_assert(Scanner::keywordType("else") == TokenType::ELSE && Scanner::keywordType("false") == TokenType::FALSE);
+static_assert(Scanner::keywordType("for") == TokenType::FOR && Scanner::keywordType("fun") == TokenType::FUN);
+static_assert(Scanner::keywordType("if") == TokenType::IF && Scanner::keywordType("nil") == TokenType::NIL);
+static_assert(Scanner::keywordType("or") == TokenType::OR && Scanner::keywordType("print") == TokenType::PRINT);
+static_assert(Scanner::keywordType("return") == TokenType::RETURN && Scanner::keywordType("super") == TokenType::SUPER);
+static_assert(Scanner::keywordType("this") == TokenType::THIS && Scanner::keywordType("true") == TokenType::TRUE);
+static_assert(Scanner::keywordType("var") == TokenType::VAR && Scanner::keywordType("while") == TokenType::WHILE);
+static_assert(Scanner::keywordType("f") == TokenType::IDENTIFIER && Scanner::keywordType("classy") == TokenType::IDENTIFIER);
+static_assert(Scanner::keywordType("th") == TokenType::IDENTIFIER && Scanner::keywordType("variable") == TokenType::IDENTIFIER);
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+
+#include "LoxString.hpp"
+
+// Describes the layout of an instance: which fields it has and the slot each of them occupies in LoxInstance::fields.
+// Instances don't own a layout. They all start at the shared empty root shape and, whenever a new field is set,
+// follow (or create) the transition to the shape that has that extra field. Instances whose fields were added in the same order
+// (e.g. by the same 'init') therefore end up pointing at the very same Shape, which is what makes the inline caches work.
+// Shapes are never freed: they are owned by their parent, all the way up to the root.
+class Shape{
+  private:
+    std::unordered_map<LoxString*, int, SymbolHash> slots; // Every field of this shape, not just the last one added.
+    std::unordered_map<LoxString*, std::unique_ptr<Shape>, SymbolHash> transitions;
+
+    Shape() = default;
+
+  public:
+    Shape(const Shape&) = delete;
+    Shape& operator=(const Shape&) = delete;
+
+    // The shape of an instance with no fields.
+    static Shape* root(){
+      static Shape root;
+
+      return &root;
+    }
+
+    // Returns the slot of the field with the given name, or -1 if instances of this shape don't have it.
+    int lookup(LoxString* name) const{
+      auto elem = slots.find(name);
+      if(elem != slots.end()){
+        return elem->second;
+      }
+
+      return -1;
+    }
+
+    // Returns the shape of an instance of this shape after the field with the given name is added to it.
+    // The new field always takes the next free slot.
+    Shape* addField(LoxString* name){
+      auto elem = transitions.find(name);
+      if(elem != transitions.end()){
+        return elem->second.get();
+      }
+
+      std::unique_ptr<Shape> next{new Shape{}};
+      next->slots = slots;
+      next->slots.emplace(name, slots.size());
+
+      Shape* shape = next.get();
+      transitions.emplace(name, std::move(next));
+
+      return shape;
+    }
+
+    int fieldCount() const{
+      return slots.size();
+    }
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <utility>
+#include <string_view>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// The text of a script. Regular files are memory-mapped, so the Scanner reads the page cache directly instead of a copy of it.
+// Anything that can't be mapped (pipes, terminals, /dev/stdin) is read into a string instead, and so are the lines typed in the prompt.
+class SourceBuffer{
+  private:
+    std::string contents; // Only used when the source isn't mapped.
+    const char* mapped = nullptr;
+    size_t mappedSize = 0;
+
+    bool readAll(int fd){
+      char chunk[64 * 1024];
+      for(;;){
+        ssize_t count = ::read(fd, chunk, sizeof(chunk));
+        if(count == 0) return true;
+        if(count < 0) return false;
+        contents.append(chunk, count);
+      }
+    }
+
+    void unmap(){
+      if(mapped != nullptr){
+        ::munmap(const_cast<char*>(mapped), mappedSize);
+        mapped = nullptr;
+        mappedSize = 0;
+      }
+
+      return;
+    }
+
+  public:
+    SourceBuffer() = default;
+
+    explicit SourceBuffer(std::string contents)
+      : contents{std::move(contents)}
+    {}
+
+    SourceBuffer(SourceBuffer&& other) noexcept
+      : contents{std::move(other.contents)}, mapped{std::exchange(other.mapped, nullptr)}, mappedSize{std::exchange(other.mappedSize, 0)}
+    {}
+
+    SourceBuffer& operator=(SourceBuffer&& other) noexcept{
+      if(this != &other){
+        unmap();
+        contents = std::move(other.contents);
+        mapped = std::exchange(other.mapped, nullptr);
+        mappedSize = std::exchange(other.mappedSize, 0);
+      }
+
+      return *this;
+    }
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    ~SourceBuffer(){
+      unmap();
+    }
+
+    // Loads the file at 'path'. Returns false (with errno set) if it can't be opened or read.
+    bool load(const char* path){
+      int fd = ::open(path, O_RDONLY);
+      if(fd < 0) return false;
+
+      struct stat info;
+      if(::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0){
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        flags |= MAP_POPULATE; // Fault the whole file in with one call instead of one page at a time while scanning.
+#endif
+        void* memory = ::mmap(nullptr, info.st_size, PROT_READ, flags, fd, 0);
+        if(memory != MAP_FAILED){
+          ::madvise(memory, info.st_size, MADV_SEQUENTIAL);
+          mapped = static_cast<const char*>(memory);
+          mappedSize = info.st_size;
+          ::close(fd);
+          return true;
+        }
+      }
+
+      bool ok = readAll(fd);
+      ::close(fd);
+
+      return ok;
+    }
+
+    std::string_view view() const{
+      if(mapped != nullptr){
+        return std::string_view{mapped, mappedSize};
+      }
+
+      return contents;
+    }
+};
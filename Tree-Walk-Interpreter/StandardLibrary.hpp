@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <random>
+#include <utility>
+#include <charconv>
+#include <algorithm>
+#include <string_view>
+
+#include "VM.hpp"
+#include "Token.hpp"
+#include "Value.hpp"
+#include "LoxClass.hpp"
+#include "LoxString.hpp"
+#include "Interpreter.hpp"
+#include "LoxInstance.hpp"
+#include "LoxCallable.hpp"
+#include "RuntimeError.hpp"
+#include "PropertyCache.hpp"
+
+// The native functions every script can call. Each one checks its own arguments (the call already checked how many there are)
+// and reports bad ones with a NativeError, which becomes a runtime error at the call site.
+//
+//   Math:        abs(x) floor(x) ceil(x) round(x) trunc(x) sqrt(x) exp(x) log(x) sin(x) cos(x) tan(x) atan2(y, x)
+//                pow(x, y) mod(x, y) min(x, y) max(x, y)
+//   Strings:     len(s) substring(s, start, end) indexOf(s, part)
+//   Conversions: toString(value) parseNumber(s)
+//   Time:        clock() nanoTime() benchmark(function, warmup, iterations)
+class StandardLibrary{
+  private:
+    using Arguments = std::vector<Value>;
+    using Clock = std::chrono::steady_clock; // Monotonic: it never jumps when the system time is adjusted.
+
+    static inline const Clock::time_point start = Clock::now(); // clock() and nanoTime() count from here.
+
+    // The class of the instances benchmark() returns, and the fields it sets on them. The caches make filling in every
+    // instance after the first one as cheap as it is for a script. The class is never freed, like the symbols.
+    struct ResultField{
+      Token name;
+      PropertyCache cache;
+    };
+    static inline LoxClass* resultClass = nullptr;
+    static inline std::vector<ResultField> resultFields;
+
+    static double number(const Value& value, const char* function){
+      if(!value.isNumber()){
+        throw NativeError{std::string{"Argument to '"} + function + "' must be a number."};
+      }
+
+      return value.asNumber();
+    }
+
+    static LoxString* string(const Value& value, const char* function){
+      if(!value.isString()){
+        throw NativeError{std::string{"Argument to '"} + function + "' must be a string."};
+      }
+
+      return value.asObject<LoxString>();
+    }
+
+    // Past 2^53 not every whole number is a double anyway, and it's far below the largest size_t, where the conversion breaks.
+    static constexpr double MAX_COUNT = 9007199254740992.0;
+
+    static size_t count(const Value& value, const char* function){
+      double amount = number(value, function);
+      if(amount != std::floor(amount) || amount < 0){
+        throw NativeError{std::string{"Argument to '"} + function + "' must be a whole number."};
+      }
+      if(amount > MAX_COUNT){
+        throw NativeError{std::string{"Argument to '"} + function + "' is too large."};
+      }
+
+      return static_cast<size_t>(amount);
+    }
+
+    // A position in a string of 'length' characters: from 0 to 'length' (one past the last character).
+    static size_t position(const Value& value, size_t length, const char* function){
+      size_t index = count(value, function);
+      if(index > length){
+        throw NativeError{std::string{"Index out of bounds in '"} + function + "'."};
+      }
+
+      return index;
+    }
+
+    // Calls Lox code from a native, on whichever engine is running the script.
+    static Value callBack(Interpreter& interpreter, const Value& callee, std::vector<Value> arguments){
+      if(interpreter.vm != nullptr){
+        return interpreter.vm->call(callee, std::move(arguments));
+      }
+
+      return callee.asObject<LoxCallable>()->call(interpreter, std::move(arguments));
+    }
+
+    // benchmark() keeps at most this many of the times it measures, for the percentiles. Past that, each time replaces a kept one
+    // with the probability that keeps every time equally likely to be among them (reservoir sampling). The mean and min are exact.
+    static constexpr size_t BENCHMARK_SAMPLES = 10000;
+
+    // Times 'iterations' calls of 'function' (after 'warmup' untimed ones) and returns the statistics, in nanoseconds.
+    static Value benchmark(Interpreter& interpreter, const Value& function, size_t warmup, size_t iterations){
+      for(size_t i = 0; i < warmup; i++){
+        callBack(interpreter, function, {});
+      }
+
+      std::vector<double> samples;
+      samples.reserve(std::min(iterations, BENCHMARK_SAMPLES));
+      std::minstd_rand random{};
+      double total = 0;
+      double fastest = INFINITY;
+      for(size_t i = 0; i < iterations; i++){
+        Clock::time_point before = Clock::now();
+        callBack(interpreter, function, {});
+        double sample = std::chrono::duration<double, std::nano>{Clock::now() - before}.count();
+
+        total += sample;
+        fastest = std::min(fastest, sample);
+        if(samples.size() < BENCHMARK_SAMPLES){
+          samples.push_back(sample);
+        }else{
+          size_t kept = std::uniform_int_distribution<size_t>{0, i}(random);
+          if(kept < BENCHMARK_SAMPLES) samples[kept] = sample;
+        }
+      }
+      std::sort(samples.begin(), samples.end());
+
+      // Nearest-rank percentiles: the smallest sample that's at least as large as that fraction of them.
+      auto percentile = [&samples](double fraction){
+        size_t rank = static_cast<size_t>(std::ceil(fraction * samples.size()));
+        return samples[std::max<size_t>(rank, 1) - 1];
+      };
+      double statistics[] = {
+        total / iterations,
+        fastest,
+        percentile(0.50),
+        percentile(0.99)
+      };
+
+      Ref<LoxInstance> result = makeRef<LoxInstance>(Ref<LoxClass>{resultClass});
+      for(size_t i = 0; i < resultFields.size(); i++){
+        result->set(resultFields[i].name, statistics[i], resultFields[i].cache);
+      }
+
+      return Value{std::move(result)};
+    }
+
+  public:
+    static void define(Interpreter& interpreter){
+      interpreter.defineNative("abs", 1, [](Interpreter&, Arguments& arguments) -> Value{ return std::fabs(number(arguments[0], "abs")); });
+      interpreter.defineNative("floor", 1, [](Interpreter&, Arguments& arguments) -> Value{ return std::floor(number(arguments[0], "floor")); });
+      interpreter.defineNative("ceil", 1, [](Interpreter&, Arguments& arguments) -> Value{ return std::ceil(number(arguments[0], "ceil")); });
+      interpreter.defineNative("round", 1, [](Interpreter&, Arguments& arguments) -> Value{ return std::round(number(arguments[0], "round")); });
+      interpreter.defineNative("trunc", 1, [](Interpreter&, Arguments& arguments) -> Value{ return std::trunc(number(arguments[0], "trunc")); });
+      interpreter.defineNative("sqrt", 1, [](Interpreter&, Arguments& arguments) -> Value{ return std::sqrt(number(arguments[0], "sqrt")); });
+      interpreter.defineNative("exp", 1, [](Interpreter&, Arguments& arguments) -> Value{ return std::exp(number(arguments[0], "exp")); });
+      interpreter.defineNative("log", 1, [](Interpreter&, Arguments& arguments) -> Value{ return std::log(number(arguments[0], "log")); });
+      interpreter.defineNative("sin", 1, [](Interpreter&, Arguments& arguments) -> Value{ return std::sin(number(arguments[0], "sin")); });
+      interpreter.defineNative("cos", 1, [](Interpreter&, Arguments& arguments) -> Value{ return std::cos(number(arguments[0], "cos")); });
+      interpreter.defineNative("tan", 1, [](Interpreter&, Arguments& arguments) -> Value{ return std::tan(number(arguments[0], "tan")); });
+      interpreter.defineNative("atan2", 2, [](Interpreter&, Arguments& arguments) -> Value{
+        return std::atan2(number(arguments[0], "atan2"), number(arguments[1], "atan2"));
+      });
+      interpreter.defineNative("pow", 2, [](Interpreter&, Arguments& arguments) -> Value{
+        return std::pow(number(arguments[0], "pow"), number(arguments[1], "pow"));
+      });
+      interpreter.defineNative("mod", 2, [](Interpreter&, Arguments& arguments) -> Value{
+        return std::fmod(number(arguments[0], "mod"), number(arguments[1], "mod"));
+      });
+      interpreter.defineNative("min", 2, [](Interpreter&, Arguments& arguments) -> Value{
+        return std::fmin(number(arguments[0], "min"), number(arguments[1], "min"));
+      });
+      interpreter.defineNative("max", 2, [](Interpreter&, Arguments& arguments) -> Value{
+        return std::fmax(number(arguments[0], "max"), number(arguments[1], "max"));
+      });
+
+      interpreter.defineNative("len", 1, [](Interpreter&, Arguments& arguments) -> Value{
+        return static_cast<double>(string(arguments[0], "len")->chars().length());
+      });
+      interpreter.defineNative("substring", 3, [](Interpreter&, Arguments& arguments) -> Value{
+        std::string_view chars = string(arguments[0], "substring")->chars();
+        size_t start = position(arguments[1], chars.length(), "substring");
+        size_t end = position(arguments[2], chars.length(), "substring");
+        if(start > end){
+          throw NativeError{"The start of a substring can't be after its end."};
+        }
+
+        return makeString(std::string{chars.substr(start, end - start)});
+      });
+      interpreter.defineNative("indexOf", 2, [](Interpreter&, Arguments& arguments) -> Value{
+        size_t index = string(arguments[0], "indexOf")->chars().find(string(arguments[1], "indexOf")->chars());
+
+        return index == std::string_view::npos ? -1.0 : static_cast<double>(index);
+      });
+
+      // Strings are returned as they are, anything else is converted the way 'print' shows it.
+      interpreter.defineNative("toString", 1, [](Interpreter& interpreter, Arguments& arguments) -> Value{
+        if(arguments[0].isString()) return arguments[0];
+
+        return makeString(interpreter.stringify(arguments[0]));
+      });
+      // Returns nil if the whole string isn't a number.
+      interpreter.defineNative("parseNumber", 1, [](Interpreter&, Arguments& arguments) -> Value{
+        std::string_view chars = string(arguments[0], "parseNumber")->chars();
+        double value = 0;
+        auto [end, error] = std::from_chars(chars.data(), chars.data() + chars.size(), value);
+        if(chars.empty() || error != std::errc{} || end != chars.data() + chars.size()){
+          return nullptr;
+        }
+
+        return value;
+      });
+
+      // Seconds since the program started.
+      interpreter.defineNative("clock", 0, [](Interpreter&, Arguments&) -> Value{
+        return std::chrono::duration<double>{Clock::now() - start}.count();
+      });
+      // Nanoseconds since the program started, as a whole number (exact for the first 104 days).
+      interpreter.defineNative("nanoTime", 0, [](Interpreter&, Arguments&) -> Value{
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+      });
+
+      resultClass = new LoxClass{"BenchmarkResult", nullptr, LoxClass::MethodTable{}};
+      resultClass->retain();
+      for(const char* name : {"mean", "min", "p50", "p99"}){
+        resultFields.push_back(ResultField{Token{0, TokenType::IDENTIFIER, name, intern(name)}, PropertyCache{}});
+      }
+      // benchmark(function, warmup, iterations) calls 'function' (which takes no arguments) 'warmup' times to warm it up, then
+      // times 'iterations' more calls. It returns an instance with the mean, min, p50 and p99 of those times, in nanoseconds
+      // (the percentiles of a sample of BENCHMARK_SAMPLES of them, when there are more).
+      interpreter.defineNative("benchmark", 3, [](Interpreter& interpreter, Arguments& arguments) -> Value{
+        if(!arguments[0].isCallable() || arguments[0].asObject<LoxCallable>()->arity() != 0){
+          throw NativeError{"The first argument to 'benchmark' must be a function without parameters."};
+        }
+        size_t warmup = count(arguments[1], "benchmark");
+        size_t iterations = count(arguments[2], "benchmark");
+        if(iterations == 0){
+          throw NativeError{"'benchmark' needs at least one iteration."};
+        }
+
+        return benchmark(interpreter, arguments[0], warmup, iterations);
+      });
+
+      return;
+    }
+};
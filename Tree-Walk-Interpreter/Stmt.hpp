@@ -1,6 +1,5 @@
 #pragma once
 
-#include <any>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -8,6 +7,8 @@
 #include "Expr.hpp"
 #include "Token.hpp"
 
+struct Chunk;
+
 struct Block;
 struct Class;
 struct Expression;
@@ -19,135 +20,158 @@ struct Var;
 struct While;
 
 struct StmtVisitor{
-  virtual std::any visitBlockStmt(std::shared_ptr<Block> stmt) = 0;
-  virtual std::any visitClassStmt(std::shared_ptr<Class> stmt) = 0;
-  virtual std::any visitExpressionStmt(std::shared_ptr<Expression> stmt) = 0;
-  virtual std::any visitFunctionStmt(std::shared_ptr<Function> stmt) = 0;
-  virtual std::any visitIfStmt(std::shared_ptr<If> stmt) = 0;
-  virtual std::any visitPrintStmt(std::shared_ptr<Print> stmt) = 0;
-  virtual std::any visitReturnStmt(std::shared_ptr<Return> stmt) = 0;
-  virtual std::any visitVarStmt(std::shared_ptr<Var> stmt) = 0;
-  virtual std::any visitWhileStmt(std::shared_ptr<While> stmt) = 0;
+  virtual void visitBlockStmt(Block* stmt) = 0;
+  virtual void visitClassStmt(Class* stmt) = 0;
+  virtual void visitExpressionStmt(Expression* stmt) = 0;
+  virtual void visitFunctionStmt(Function* stmt) = 0;
+  virtual void visitIfStmt(If* stmt) = 0;
+  virtual void visitPrintStmt(Print* stmt) = 0;
+  virtual void visitReturnStmt(Return* stmt) = 0;
+  virtual void visitVarStmt(Var* stmt) = 0;
+  virtual void visitWhileStmt(While* stmt) = 0;
   virtual ~StmtVisitor() = default;
 };
 
 struct Stmt{
-  virtual std::any accept(StmtVisitor& visitor) = 0;
+  virtual void accept(StmtVisitor& visitor) = 0;
 };
 
-struct Block : Stmt, public std::enable_shared_from_this<Block>{
-  const std::vector<std::shared_ptr<Stmt>> statements;
+struct Block : Stmt{
+  std::vector<Stmt*> statements;
+  bool onStack = false; // Set by the Resolver when no closure can capture the block's variables: they go on the value stack.
+  int frameSize = 0;    // If the block starts a new frame on the value stack (it isn't already inside one), the slots it needs.
 
-  Block(std::vector<std::shared_ptr<Stmt>> statements)
+  Block(std::vector<Stmt*> statements)
     : statements{std::move(statements)}
   {}
 
-  std::any accept(StmtVisitor& visitor) override{
-    return visitor.visitBlockStmt(shared_from_this());
+  void accept(StmtVisitor& visitor) override{
+    visitor.visitBlockStmt(this);
   }
 };
 
-struct Class : Stmt, public std::enable_shared_from_this<Class>{
+struct Class : Stmt{
   const Token name;
-  const std::shared_ptr<Variable> superclass;
-  const std::vector<std::shared_ptr<Function>> methods;
+  Variable* const superclass;
+  const std::vector<Function*> methods;
 
-  Class(Token name, std::shared_ptr<Variable> superclass, std::vector<std::shared_ptr<Function>> methods)
+  Class(Token name, Variable* superclass, std::vector<Function*> methods)
     : name{std::move(name)}, superclass{std::move(superclass)}, methods{std::move(methods)}
   {}
 
-  std::any accept(StmtVisitor& visitor) override{
-    return visitor.visitClassStmt(shared_from_this());
+  void accept(StmtVisitor& visitor) override{
+    visitor.visitClassStmt(this);
   }
 };
 
-struct Expression : Stmt, public std::enable_shared_from_this<Expression>{
-  const std::shared_ptr<Expr> expression;
+struct Expression : Stmt{
+  Expr* expression;
 
-  Expression(std::shared_ptr<Expr> expression)
+  Expression(Expr* expression)
     : expression{std::move(expression)}
   {}
 
-  std::any accept(StmtVisitor& visitor) override{
-    return visitor.visitExpressionStmt(shared_from_this());
+  void accept(StmtVisitor& visitor) override{
+    visitor.visitExpressionStmt(this);
   }
 };
 
-struct Function : Stmt, public std::enable_shared_from_this<Function>{
+struct Function : Stmt{
   const Token name;
   const std::vector<Token> parameters;
-  const std::vector<std::shared_ptr<Stmt>> body;
+  std::vector<Stmt*> body;
+  std::shared_ptr<Chunk> chunk; // Bytecode for the body, filled in by the Compiler when the VM is used.
+  bool onStack = false; // Set by the Resolver when the body declares no functions or classes, so nothing can capture its variables.
+  int frameSize = 0;    // Slots its frame needs on the value stack: receiver, parameters and every local of the body.
 
-  Function(Token name, std::vector<Token> parameters, std::vector<std::shared_ptr<Stmt>> body)
+  Function(Token name, std::vector<Token> parameters, std::vector<Stmt*> body)
     : name{std::move(name)}, parameters{std::move(parameters)}, body{std::move(body)}
   {}
 
-  std::any accept(StmtVisitor& visitor) override{
-    return visitor.visitFunctionStmt(shared_from_this());
+  void accept(StmtVisitor& visitor) override{
+    visitor.visitFunctionStmt(this);
   }
 };
 
-struct If : Stmt, public std::enable_shared_from_this<If>{
-  std::shared_ptr<Expr> condition;
-  std::shared_ptr<Stmt> ifBranch;
-  std::shared_ptr<Stmt> elseBranch;
+struct If : Stmt{
+  Expr* condition;
+  Stmt* ifBranch;
+  Stmt* elseBranch;
 
-  If(std::shared_ptr<Expr> condition, std::shared_ptr<Stmt> ifBranch, std::shared_ptr<Stmt> elseBranch)
+  If(Expr* condition, Stmt* ifBranch, Stmt* elseBranch)
     : condition{std::move(condition)}, ifBranch{std::move(ifBranch)}, elseBranch{std::move(elseBranch)}
   {}
 
-  std::any accept(StmtVisitor& visitor) override{
-    return visitor.visitIfStmt(shared_from_this());
+  void accept(StmtVisitor& visitor) override{
+    visitor.visitIfStmt(this);
   }
 };
 
-struct Print : Stmt, public std::enable_shared_from_this<Print>{
-  const std::shared_ptr<Expr> expression;
+struct Print : Stmt{
+  Expr* expression;
 
-  Print(std::shared_ptr<Expr> expression)
+  Print(Expr* expression)
     : expression{std::move(expression)}
   {}
 
-  std::any accept(StmtVisitor& visitor) override{
-    return visitor.visitPrintStmt(shared_from_this());
+  void accept(StmtVisitor& visitor) override{
+    visitor.visitPrintStmt(this);
   }
 };
 
-struct Return : Stmt, public std::enable_shared_from_this<Return>{
+struct Return : Stmt{
   const Token keyword;
-  const std::shared_ptr<Expr> value;
+  Expr* value;
+  bool tailCall = false; // Set by the Parser, and again by the ConstantFolder, when isTailCall(value). The Interpreter then makes the call without nesting.
 
-  Return(Token keyword, std::shared_ptr<Expr> value)
+  Return(Token keyword, Expr* value)
     : keyword{std::move(keyword)}, value{std::move(value)}
   {}
 
-  std::any accept(StmtVisitor& visitor) override{
-    return visitor.visitReturnStmt(shared_from_this());
+  // Whether 'value' can end with a call whose result is returned as it is: "f(x)", "(f(x))", or "a or f(x)" and "a and f(x)",
+  // when the left operand doesn't decide the result. The VM finds the same calls from the bytecode (a call right before OP_RETURN).
+  static bool isTailCall(Expr* value){
+    if(dynamic_cast<Call*>(value) != nullptr){
+      return true;
+    }
+    if(auto grouping = dynamic_cast<Grouping*>(value)){
+      return isTailCall(grouping->expression);
+    }
+    if(auto logical = dynamic_cast<Logical*>(value)){
+      return isTailCall(logical->right);
+    }
+
+    return false;
+  }
+
+  void accept(StmtVisitor& visitor) override{
+    visitor.visitReturnStmt(this);
   }
 };
 
-struct Var : Stmt, public std::enable_shared_from_this<Var>{
+struct Var : Stmt{
   const Token name;
-  const std::shared_ptr<Expr> initializer;
+  Expr* initializer;
+  LocalSlot local; // Where the Resolver put the variable. Only 'onStack' and 'slot' are meaningful.
 
-  Var(Token name, std::shared_ptr<Expr> initializer)
+  Var(Token name, Expr* initializer)
     : name{std::move(name)}, initializer{std::move(initializer)}
   {}
 
-  std::any accept(StmtVisitor& visitor) override{
-    return visitor.visitVarStmt(shared_from_this());
+  void accept(StmtVisitor& visitor) override{
+    visitor.visitVarStmt(this);
   }
 };
 
-struct While : Stmt, public std::enable_shared_from_this<While>{
-  const std::shared_ptr<Expr> condition;
-  const std::shared_ptr<Stmt> body;
+struct While : Stmt{
+  Expr* condition;
+  Stmt* body;
 
-  While(std::shared_ptr<Expr> condition, std::shared_ptr<Stmt> body)
+  While(Expr* condition, Stmt* body)
     : condition{std::move(condition)}, body{std::move(body)}
   {}
 
-  std::any accept(StmtVisitor& visitor) override{
-    return visitor.visitWhileStmt(shared_from_this());
+  void accept(StmtVisitor& visitor) override{
+    visitor.visitWhileStmt(this);
   }
 };
\ No newline at end of file
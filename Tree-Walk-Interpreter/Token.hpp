@@ -1,20 +1,33 @@
 #pragma once
 
-#include <any>
 #include <string>
-#include <utility>
+#include <string_view>
 
+#include "LoxString.hpp"
 #include "TokenType.hpp"
 
+// Tokens don't own any text: the lexeme points straight into the source buffer,
+// which the CompilationUnit keeps alive for as long as the AST built from these tokens.
 class Token{
   public:
-    const int line;
-    const TokenType type;
-    const std::any literal;
-    const std::string lexeme;
+    int line;
+    TokenType type;
+    std::string_view lexeme;
+    union{
+      double number;     // Value of a NUMBER token.
+      LoxString* symbol; // Interned name of an IDENTIFIER token, or the interned characters between the quotes of a STRING token.
+    };
 
-    Token(int line, TokenType type, std::any literal, std::string lexeme)
-      : line{line}, type{type}, literal{std::move(literal)}, lexeme{std::move(lexeme)}
+    Token(int line, TokenType type, std::string_view lexeme)
+      : line{line}, type{type}, lexeme{lexeme}, number{0}
+    {}
+
+    Token(int line, TokenType type, std::string_view lexeme, double number)
+      : line{line}, type{type}, lexeme{lexeme}, number{number}
+    {}
+
+    Token(int line, TokenType type, std::string_view lexeme, LoxString* symbol)
+      : line{line}, type{type}, lexeme{lexeme}, symbol{symbol}
     {}
 
     std::string toString() const{
@@ -25,10 +38,10 @@ class Token{
           literal_text = lexeme;
           break;
         case (TokenType::STRING):
-          literal_text = std::any_cast<std::string>(literal);
+          literal_text = symbol->chars();
           break;
         case (TokenType::NUMBER):
-          literal_text = std::to_string(std::any_cast<double>(literal));
+          literal_text = std::to_string(number);
           break;
         case (TokenType::TRUE):
           literal_text = "true";
@@ -41,6 +54,6 @@ class Token{
           break;
       }
 
-      return ::toString(type) + " " + lexeme + " " + literal_text;
+      return ::toString(type) + " " + std::string{lexeme} + " " + literal_text;
     }
 };
\ No newline at end of file
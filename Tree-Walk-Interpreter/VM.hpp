@@ -0,0 +1,551 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <iostream>
+
+#include "Stmt.hpp"
+#include "Chunk.hpp"
+#include "Error.hpp"
+#include "Value.hpp"
+#include "Compiler.hpp"
+#include "Collector.hpp"
+#include "LoxClass.hpp"
+#include "Environment.hpp"
+#include "Interpreter.hpp"
+#include "LoxFunction.hpp"
+#include "LoxInstance.hpp"
+#include "RuntimeError.hpp"
+
+// Stack-based virtual machine that executes the bytecode produced by the Compiler.
+// It shares the runtime objects (environments, functions, classes and instances) and the global scope with the Interpreter,
+// so both engines can run the same scripts and be compared side by side.
+class VM{
+  private:
+    struct CallFrame{
+      Ref<LoxFunction> function; // Null for the top-level script.
+      const Chunk* chunk;
+      const uint8_t* ip;
+      Ref<Environment> environment;
+      Environment* locals; // The function's own environment (receiver and parameters). 'environment' may be a nested block.
+      size_t stackBase; // Index of the stack slot that held the callee. The return value replaces it.
+      size_t slotBase; // Index of slot 0 for the variables that live on the stack (LocalSlot::onStack).
+    };
+
+    Interpreter& interpreter;
+    std::vector<Value> stack;
+    std::vector<CallFrame> frames;
+    CallFrame* frame = nullptr; // Always points to frames.back() while the VM is running. Null while a native calls back (see call).
+    size_t returnDepth = 0; // run() also stops when a return leaves this many frames, for calls made by natives.
+    const Token* nativeCallSite = nullptr; // The call of the native that's running, to report errors in the calls it makes.
+
+    uint8_t readByte(){
+      return *frame->ip++;
+    }
+
+    uint16_t readShort(){
+      uint16_t value = frame->ip[0] | (frame->ip[1] << 8);
+      frame->ip += 2;
+
+      return value;
+    }
+
+    // Token of the instruction that starts at 'instruction', used for names and for reporting runtime errors.
+    const Token& tokenAt(const uint8_t* instruction){
+      return *frame->chunk->tokens[instruction - frame->chunk->code.data()];
+    }
+
+    void push(Value value){
+      stack.push_back(std::move(value));
+
+      return;
+    }
+
+    Value pop(){
+      Value value = std::move(stack.back());
+      stack.pop_back();
+
+      return value;
+    }
+
+    Value& peek(int distance){
+      return stack[stack.size() - 1 - distance];
+    }
+
+    void checkNumberOperands(const Token& op){
+      if(peek(0).isNumber() && peek(1).isNumber()) return;
+      throw RuntimeError{op, "Operands must be both numbers"};
+    }
+
+    // Methods get their receiver in slot 0, before the arguments (see Resolver::resolveFunction).
+    void callFunction(const Token& paren, Ref<LoxFunction> function, const Value& receiver, int argCount){
+      Collector::instance().collectIfNeeded(); // Calls are safe points.
+
+      // A call whose result is returned right away ("return f(...);") replaces the frame of the function that makes it:
+      // the callee and its arguments move down to where that function's callee was. Like in the tree-walker (see
+      // LoxFunction::invoke), tail calls run in constant space and don't count towards the call depth limit.
+      if(frame != nullptr && *frame->ip == OP_RETURN && frame->function != nullptr && !frame->function->isInitializer){
+        size_t calleeIndex = stack.size() - argCount - 1;
+        std::move(stack.begin() + calleeIndex, stack.end(), stack.begin() + frame->stackBase);
+        stack.resize(frame->stackBase + argCount + 1);
+        frames.pop_back();
+      }else if(frames.size() > interpreter.maxCallDepth){ // The top-level script has a frame too.
+        throw RuntimeError{paren, "Stack overflow."};
+      }
+
+      const Chunk* chunk = function->declaration->chunk.get();
+      size_t stackBase = stack.size() - argCount - 1;
+
+      if(function->declaration->onStack){
+        // The arguments are already where the frame's slots start. A method's receiver goes in slot 0, where the callee was.
+        size_t slotBase = stackBase + 1;
+        if(!receiver.isNil()){
+          stack[stackBase] = receiver;
+          slotBase = stackBase;
+        }
+        stack.resize(slotBase + function->declaration->frameSize);
+
+        Ref<Environment> closure = function->closure;
+        frames.push_back(CallFrame{std::move(function), chunk, chunk->code.data(), std::move(closure), nullptr, stackBase, slotBase});
+        frame = &frames.back();
+        return;
+      }
+
+      auto environment = makeRef<Environment>(function->closure);
+      environment->slots.reserve(argCount + 1);
+      if(!receiver.isNil()){
+        environment->slots.push_back(receiver);
+      }
+      environment->slots.insert(environment->slots.end(), std::make_move_iterator(stack.end() - argCount), std::make_move_iterator(stack.end()));
+      stack.resize(stack.size() - argCount);
+
+      Environment* locals = environment.get();
+      frames.push_back(CallFrame{std::move(function), chunk, chunk->code.data(), std::move(environment), locals, stackBase, stackBase + 1});
+      frame = &frames.back();
+
+      return;
+    }
+
+    // Makes 'paren' the call site of the native that's running, and puts the previous one back when the native returns or throws.
+    struct NativeCallSite{
+      VM& vm;
+      const Token* previous;
+
+      NativeCallSite(VM& vm, const Token& paren)
+        : vm{vm}, previous{vm.nativeCallSite}
+      {
+        vm.nativeCallSite = &paren;
+      }
+
+      ~NativeCallSite(){
+        vm.nativeCallSite = previous;
+      }
+    };
+
+    // Calls anything that isn't compiled to bytecode (native functions) and leaves the result in place of the callee.
+    void callNative(const Token& paren, LoxCallable* function, int argCount){
+      std::vector<Value> arguments{std::make_move_iterator(stack.end() - argCount), std::make_move_iterator(stack.end())};
+      stack.resize(stack.size() - argCount);
+
+      NativeCallSite callSite{*this, paren};
+      Value result;
+      try{
+        result = function->call(interpreter, std::move(arguments));
+      }catch(const NativeError& error){
+        throw RuntimeError{paren, error.what()};
+      }
+      stack.back() = std::move(result);
+
+      return;
+    }
+
+    void callValue(const Token& paren, int argCount){
+      Value& callee = peek(argCount);
+      if(!callee.isCallable()){
+        throw RuntimeError{paren, "Can only call functions and classes."};
+      }
+
+      LoxCallable* function = callee.asObject<LoxCallable>();
+      if(argCount != function->arity()){
+        throw RuntimeError{paren, "Expected " + std::to_string(function->arity()) + " arguments, but received " + std::to_string(argCount) + "."};
+      }
+
+      if(callee.isFunction()){
+        LoxFunction* loxFunction = callee.asObject<LoxFunction>();
+        if(loxFunction->declaration->chunk != nullptr){
+          callFunction(paren, Ref<LoxFunction>{loxFunction}, loxFunction->receiver, argCount);
+        }else{
+          callNative(paren, function, argCount);
+        }
+      }else if(callee.isClass()){
+        Ref<LoxClass> klass{callee.asObject<LoxClass>()};
+        auto instance = makeRef<LoxInstance>(klass);
+        callee = instance; // Whatever the initializer does, the call evaluates to the new instance.
+
+        if(klass->initializer != nullptr){
+          callFunction(paren, klass->initializer, instance, argCount);
+        }
+      }else{
+        callNative(paren, function, argCount);
+      }
+
+      return;
+    }
+
+    // "object.name(...)": calls the method directly with 'object' as its receiver, without binding it first.
+    // If 'name' is a field instead, it behaves just like OP_GET_PROPERTY followed by OP_CALL.
+    void invoke(const Token& name, const Token& paren, PropertyCache& cache, int argCount){
+      Value& object = peek(argCount);
+      if(!object.isInstance()){
+        throw RuntimeError(name, "Only instances have properties.");
+      }
+
+      LoxInstance* instance = object.asObject<LoxInstance>();
+      Value* field = instance->findField(name, cache);
+      if(field == nullptr){
+        LoxFunction* method = instance->findMethod(name.symbol);
+        if(method != nullptr && method->declaration->chunk != nullptr){
+          if(argCount != method->arity()){
+            throw RuntimeError{paren, "Expected " + std::to_string(method->arity()) + " arguments, but received " + std::to_string(argCount) + "."};
+          }
+
+          Value receiver = object;
+          callFunction(paren, Ref<LoxFunction>{method}, receiver, argCount);
+          return;
+        }
+      }
+
+      Value callee = field != nullptr ? *field : instance->get(name, cache);
+      object = std::move(callee);
+      callValue(paren, argCount);
+
+      return;
+    }
+
+    Ref<LoxClass> createClass(const Class& declaration, Value superclass){
+      Ref<Environment> environment = frame->environment;
+      if(superclass.isClass()){
+        environment = makeRef<Environment>(environment);
+        environment->define(superclass);
+      }
+
+      LoxClass::MethodTable methods;
+      for(Function* method : declaration.methods){
+        methods[method->name.symbol] = makeRef<LoxFunction>(method, environment, method->name.lexeme == "init");
+      }
+
+      Ref<LoxClass> superklass = nullptr;
+      if(superclass.isClass()){
+        superklass = superclass.asObject<LoxClass>();
+      }
+
+      return makeRef<LoxClass>(std::string{declaration.name.lexeme}, std::move(superklass), std::move(methods));
+    }
+
+    void run(){
+      for(;;){
+        const uint8_t* instruction = frame->ip;
+
+        switch(readByte()){
+          case OP_CONSTANT:
+            push(frame->chunk->constants[readShort()]);
+            break;
+          case OP_NIL:
+            push(nullptr);
+            break;
+          case OP_TRUE:
+            push(true);
+            break;
+          case OP_FALSE:
+            push(false);
+            break;
+          case OP_POP:
+            stack.pop_back();
+            break;
+
+          case OP_GET_LOCAL:{
+            int depth = readShort();
+            int slot = readShort();
+            push(frame->environment->getAt(depth, slot));
+            break;
+          }
+          case OP_SET_LOCAL:{
+            int depth = readShort();
+            int slot = readShort();
+            frame->environment->assignAt(depth, slot, peek(0));
+            break;
+          }
+          case OP_DEFINE_LOCAL:
+            frame->environment->define(pop());
+            break;
+          case OP_GET_STACK:
+            push(stack[frame->slotBase + readShort()]);
+            break;
+          case OP_SET_STACK:
+            stack[frame->slotBase + readShort()] = peek(0);
+            break;
+          case OP_GET_GLOBAL:
+            push(interpreter.globals->get(tokenAt(instruction)));
+            break;
+          case OP_SET_GLOBAL:
+            interpreter.globals->assign(tokenAt(instruction), peek(0));
+            break;
+          case OP_DEFINE_GLOBAL:
+            interpreter.globals->define(tokenAt(instruction).symbol, pop());
+            break;
+
+          case OP_GET_PROPERTY:{
+            PropertyCache& cache = *frame->chunk->caches[readShort()];
+            Value& object = peek(0);
+            if(!object.isInstance()){
+              throw RuntimeError(tokenAt(instruction), "Only instances have properties.");
+            }
+            object = object.asObject<LoxInstance>()->get(tokenAt(instruction), cache);
+            break;
+          }
+          case OP_SET_PROPERTY:{
+            PropertyCache& cache = *frame->chunk->caches[readShort()];
+            Value& object = peek(1);
+            if(!object.isInstance()){
+              throw RuntimeError(tokenAt(instruction), "Only instances have fields.");
+            }
+            object.asObject<LoxInstance>()->set(tokenAt(instruction), peek(0), cache);
+            object = pop();
+            break;
+          }
+          case OP_GET_SUPER:{
+            int distance = readShort();
+            const Token& name = tokenAt(instruction);
+            const Value& superclass = frame->environment->getAt(distance, 0);
+
+            Ref<LoxFunction> method = superclass.asObject<LoxClass>()->findMethod(name.symbol);
+            if(method == nullptr){
+              throw RuntimeError(name, "Undefined property '" + std::string{name.lexeme} + "'.");
+            }
+            peek(0) = method->bind(peek(0).asObject<LoxInstance>());
+            break;
+          }
+
+          case OP_EQUAL:{
+            bool equal = interpreter.isEqual(peek(1), peek(0));
+            stack.pop_back();
+            stack.back() = equal;
+            break;
+          }
+          case OP_NOT_EQUAL:{
+            bool equal = interpreter.isEqual(peek(1), peek(0));
+            stack.pop_back();
+            stack.back() = !equal;
+            break;
+          }
+          case OP_GREATER:
+            checkNumberOperands(tokenAt(instruction));
+            peek(1) = peek(1).asNumber() > peek(0).asNumber();
+            stack.pop_back();
+            break;
+          case OP_GREATER_EQUAL:
+            checkNumberOperands(tokenAt(instruction));
+            peek(1) = peek(1).asNumber() >= peek(0).asNumber();
+            stack.pop_back();
+            break;
+          case OP_LESS:
+            checkNumberOperands(tokenAt(instruction));
+            peek(1) = peek(1).asNumber() < peek(0).asNumber();
+            stack.pop_back();
+            break;
+          case OP_LESS_EQUAL:
+            checkNumberOperands(tokenAt(instruction));
+            peek(1) = peek(1).asNumber() <= peek(0).asNumber();
+            stack.pop_back();
+            break;
+          case OP_ADD:{
+            Value& left = peek(1);
+            Value& right = peek(0);
+            if(left.isNumber() && right.isNumber()){
+              left = left.asNumber() + right.asNumber();
+            }else if(left.isString() && right.isString()){
+              left = Value{LoxString::concatenate(left.asObject<LoxString>(), right.asObject<LoxString>())};
+            }else{
+              throw RuntimeError{tokenAt(instruction), "Operands must be either two numbers or two strings."};
+            }
+            stack.pop_back();
+            break;
+          }
+          case OP_SUBTRACT:
+            checkNumberOperands(tokenAt(instruction));
+            peek(1) = peek(1).asNumber() - peek(0).asNumber();
+            stack.pop_back();
+            break;
+          case OP_MULTIPLY:
+            checkNumberOperands(tokenAt(instruction));
+            peek(1) = peek(1).asNumber() * peek(0).asNumber();
+            stack.pop_back();
+            break;
+          case OP_DIVIDE:
+            checkNumberOperands(tokenAt(instruction));
+            peek(1) = peek(1).asNumber() / peek(0).asNumber();
+            stack.pop_back();
+            break;
+          case OP_NOT:
+            peek(0) = !interpreter.isTruthy(peek(0));
+            break;
+          case OP_NEGATE:
+            if(!peek(0).isNumber()){
+              throw RuntimeError{tokenAt(instruction), "Operand must be a number."};
+            }
+            peek(0) = -peek(0).asNumber();
+            break;
+
+          case OP_PRINT:
+            std::cout << interpreter.stringify(pop()) << std::endl;
+            break;
+          case OP_JUMP:{
+            uint16_t offset = readShort();
+            frame->ip += offset;
+            break;
+          }
+          case OP_JUMP_IF_FALSE:{
+            uint16_t offset = readShort();
+            if(!interpreter.isTruthy(peek(0))) frame->ip += offset;
+            break;
+          }
+          case OP_LOOP:{
+            uint16_t offset = readShort();
+            frame->ip -= offset;
+            Collector::instance().collectIfNeeded(); // So are loop iterations.
+            break;
+          }
+          case OP_PUSH_SCOPE:
+            frame->environment = makeRef<Environment>(frame->environment);
+            break;
+          case OP_POP_SCOPE:
+            frame->environment = frame->environment->enclosing;
+            break;
+          case OP_ENTER_FRAME:{
+            // The slot base it replaces goes right below the new slots, so OP_LEAVE_FRAME can put it back.
+            uint16_t size = readShort();
+            push(static_cast<double>(frame->slotBase));
+            frame->slotBase = stack.size();
+            stack.resize(stack.size() + size);
+            break;
+          }
+          case OP_LEAVE_FRAME:{
+            uint16_t size = readShort();
+            stack.resize(stack.size() - size);
+            frame->slotBase = static_cast<size_t>(pop().asNumber());
+            break;
+          }
+
+          case OP_CALL:{
+            int argCount = readByte();
+            callValue(tokenAt(instruction), argCount);
+            break;
+          }
+          case OP_INVOKE:{
+            PropertyCache& cache = *frame->chunk->caches[readShort()];
+            int argCount = readByte();
+            invoke(tokenAt(instruction), tokenAt(instruction + 3), cache, argCount);
+            break;
+          }
+          case OP_FUNCTION:{
+            Function* declaration = frame->chunk->functions[readShort()];
+            push(makeRef<LoxFunction>(declaration, frame->environment, false));
+            break;
+          }
+          case OP_CLASS:{
+            Class* declaration = frame->chunk->classes[readShort()];
+            Value superclass;
+            if(declaration->superclass != nullptr){
+              superclass = pop();
+              if(!superclass.isClass()){
+                throw RuntimeError(declaration->superclass->name, "SuperClass must also be a class.");
+              }
+            }
+            push(createClass(*declaration, std::move(superclass)));
+            break;
+          }
+          case OP_RETURN:{
+            Value result = pop();
+            if(frame->function != nullptr && frame->function->isInitializer){
+              result = frame->locals != nullptr ? frame->locals->slots[0] : stack[frame->slotBase]; // Initializers always return 'this'.
+            }
+
+            size_t stackBase = frame->stackBase;
+            frames.pop_back();
+            if(frames.empty()){ // We've just finished the top-level script.
+              stack.clear();
+              frame = nullptr;
+              return;
+            }
+
+            stack.resize(stackBase + 1);
+            stack.back() = std::move(result);
+            frame = &frames.back();
+            if(frames.size() == returnDepth) return; // Back in the native that made the call.
+            break;
+          }
+        }
+      }
+    }
+
+  public:
+    // Calls 'callee' with 'arguments' on behalf of the native function that's running, and returns the result.
+    // A function compiled to bytecode runs here, on a nested run() that stops once its frame returns.
+    Value call(const Value& callee, std::vector<Value> arguments){
+      if(interpreter.nativeStackExhausted()){ // Natives that call back into Lox are the only way the VM recurses natively.
+        throw RuntimeError{*nativeCallSite, "Stack overflow."};
+      }
+
+      int argCount = arguments.size();
+      push(callee);
+      for(Value& argument : arguments){
+        push(std::move(argument));
+      }
+
+      size_t previousDepth = returnDepth;
+      returnDepth = frames.size();
+      frame = nullptr; // Not a call from bytecode, so it can't be a tail call either.
+      callValue(*nativeCallSite, argCount);
+      if(frames.size() > returnDepth){
+        run();
+      }
+      returnDepth = previousDepth;
+      frame = &frames.back();
+
+      return pop();
+    }
+
+    VM(Interpreter& interpreter)
+      : interpreter{interpreter}
+    {
+      stack.reserve(256);
+      frames.reserve(64);
+    }
+
+    void interpret(const std::vector<Stmt*>& statements){
+      std::shared_ptr<Chunk> script = Compiler{}.compileScript(statements);
+      if(hadError) return;
+
+      frames.push_back(CallFrame{nullptr, script.get(), script->code.data(), interpreter.globals, interpreter.globals.get(), 0, 0});
+      frame = &frames.back();
+      interpreter.vm = this;
+
+      try{
+        run();
+      }catch(RuntimeError error){
+        runtimeError(error);
+        stack.clear();
+        frames.clear();
+        frame = nullptr;
+        returnDepth = 0;
+      }
+      interpreter.vm = nullptr;
+
+      return;
+    }
+};
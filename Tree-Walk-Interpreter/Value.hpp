@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+#include "Object.hpp"
+
+// Runtime representation of every Lox value: a type tag plus an 8-byte payload (16 bytes in total).
+// Numbers and booleans are stored inline. Everything else lives on the heap as an Object.
+class Value{
+  public:
+    enum class Type : uint8_t{
+      NIL,
+      BOOL,
+      NUMBER,
+      OBJECT
+    };
+
+  private:
+    Type type;
+    union{
+      bool boolean;
+      double number;
+      Object* object;
+    } as;
+
+    void retain(){
+      if(type == Type::OBJECT) as.object->retain();
+
+      return;
+    }
+
+    void release(){
+      if(type == Type::OBJECT) as.object->release();
+
+      return;
+    }
+
+  public:
+    Value()
+      : type{Type::NIL}
+    {
+      as.object = nullptr;
+    }
+
+    Value(std::nullptr_t)
+      : Value{}
+    {}
+
+    Value(bool boolean)
+      : type{Type::BOOL}
+    {
+      as.number = 0;
+      as.boolean = boolean;
+    }
+
+    Value(double number)
+      : type{Type::NUMBER}
+    {
+      as.number = number;
+    }
+
+    Value(Object* object)
+      : type{Type::OBJECT}
+    {
+      as.object = object;
+      retain();
+    }
+
+    template<class T>
+    Value(const Ref<T>& object)
+      : Value{static_cast<Object*>(object.get())}
+    {}
+
+    // Without this, string literals would silently turn into booleans.
+    Value(const char*) = delete;
+
+    Value(const Value& other)
+      : type{other.type}, as{other.as}
+    {
+      retain();
+    }
+
+    Value(Value&& other) noexcept
+      : type{other.type}, as{other.as}
+    {
+      other.type = Type::NIL;
+    }
+
+    ~Value(){
+      release();
+    }
+
+    Value& operator=(const Value& other){
+      Value copy{other};
+      std::swap(type, copy.type);
+      std::swap(as, copy.as);
+
+      return *this;
+    }
+
+    Value& operator=(Value&& other) noexcept{
+      std::swap(type, other.type);
+      std::swap(as, other.as);
+
+      return *this;
+    }
+
+    bool isNil() const{ return type == Type::NIL; }
+    bool isBool() const{ return type == Type::BOOL; }
+    bool isNumber() const{ return type == Type::NUMBER; }
+    bool isObject() const{ return type == Type::OBJECT; }
+
+    bool isObjectOf(Object::Type objectType) const{
+      return type == Type::OBJECT && as.object->type == objectType;
+    }
+
+    bool isString() const{ return isObjectOf(Object::Type::STRING); }
+    bool isFunction() const{ return isObjectOf(Object::Type::FUNCTION); }
+    bool isNative() const{ return isObjectOf(Object::Type::NATIVE); }
+    bool isClass() const{ return isObjectOf(Object::Type::CLASS); }
+    bool isInstance() const{ return isObjectOf(Object::Type::INSTANCE); }
+
+    bool isCallable() const{
+      return isObjectOf(Object::Type::FUNCTION) || isObjectOf(Object::Type::NATIVE) || isObjectOf(Object::Type::CLASS);
+    }
+
+    Type getType() const{ return type; }
+    bool asBool() const{ return as.boolean; }
+    double asNumber() const{ return as.number; }
+    Object* asObject() const{ return as.object; }
+
+    // Borrowed pointer to the object, already cast to its concrete class. Only valid while this Value is alive.
+    template<class T>
+    T* asObject() const{
+      return static_cast<T*>(as.object);
+    }
+};
+
+static_assert(sizeof(Value) == 16, "Value should fit in 16 bytes.");